@@ -0,0 +1,409 @@
+/*
+ * Microbenchmarks for the get_*_figure rasterizers.
+ *
+ * Usage: rasterizer_benchmark [min-seconds-per-case]
+ *
+ * Results are printed to stdout as JSON: one entry per workload with
+ * pixels/sec, ns/pixel, and the number of allocations and peak heap
+ * bytes needed to build a single figure.
+ */
+
+#include "drawingpane_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_MIN_TIME 0.2
+#define ZONE_WIDTH 800
+#define ZONE_HEIGHT 600
+
+typedef enum {
+	FIGURE_DDA_LINE,
+	FIGURE_BRESENHAM_LINE,
+	FIGURE_WU_LINE,
+	FIGURE_ELLIPSE,
+	FIGURE_HYPERBOLE,
+	FIGURE_BEZIER,
+	FIGURE_HERMIT,
+	FIGURE_B_SPLINE,
+	FIGURE_DDA_LINE_BATCH,
+	FIGURE_BRESENHAM_LINE_BATCH
+} FigureType;
+
+typedef struct _Workload Workload;
+struct _Workload {
+	FigureType type;
+	gint x1, y1, x2, y2;
+	gint a, b;
+	GList *points;
+	Segment *segments;
+	guint n_segments;
+	gchar *params;
+};
+
+typedef struct _AllocStats AllocStats;
+struct _AllocStats {
+	gboolean tracking;
+	guint64 allocations;
+	gint64 current_bytes;
+	gint64 peak_bytes;
+};
+
+static AllocStats alloc_stats;
+
+static const gchar *figure_names[] = {
+	"dda-line",
+	"bresenham-line",
+	"wu-line",
+	"ellipse",
+	"hyperbole",
+	"bezier",
+	"hermit",
+	"b-spline",
+	"dda-line-batch",
+	"bresenham-line-batch"
+};
+
+#if defined(__GLIBC__)
+
+/*
+ * glib allocates through malloc, so wrapping the libc allocator is
+ * enough to count every allocation made while building a figure.
+ */
+
+#include <malloc.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static void
+track_alloc(void *ptr)
+{
+	if (alloc_stats.tracking && ptr != NULL) {
+		alloc_stats.allocations++;
+		alloc_stats.current_bytes += malloc_usable_size(ptr);
+		alloc_stats.peak_bytes = MAX(alloc_stats.peak_bytes, alloc_stats.current_bytes);
+	}
+}
+
+static void
+track_free(void *ptr)
+{
+	if (alloc_stats.tracking && ptr != NULL) {
+		alloc_stats.current_bytes -= malloc_usable_size(ptr);
+	}
+}
+
+void *
+malloc(size_t size)
+{
+	void *ptr = __libc_malloc(size);
+	track_alloc(ptr);
+	return ptr;
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+	void *ptr = __libc_calloc(n, size);
+	track_alloc(ptr);
+	return ptr;
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	void *result;
+
+	track_free(ptr);
+	result = __libc_realloc(ptr, size);
+	track_alloc(result);
+
+	return result;
+}
+
+void
+free(void *ptr)
+{
+	track_free(ptr);
+	__libc_free(ptr);
+}
+
+#endif /* __GLIBC__ */
+
+static GArray *
+build_figure(Workload *workload)
+{
+	switch (workload->type) {
+	case FIGURE_DDA_LINE:
+		return get_dda_line_figure(workload->x1, workload->y1, workload->x2, workload->y2);
+	case FIGURE_BRESENHAM_LINE:
+		return get_bresenham_line_figure(workload->x1, workload->y1, workload->x2, workload->y2);
+	case FIGURE_WU_LINE:
+		return get_wu_line_figure(workload->x1, workload->y1, workload->x2, workload->y2);
+	case FIGURE_ELLIPSE:
+		return get_ellipse_figure(workload->a, workload->b,
+				- ZONE_WIDTH / 2, - ZONE_HEIGHT / 2, ZONE_WIDTH, ZONE_HEIGHT);
+	case FIGURE_HYPERBOLE:
+		return get_hyperbole_figure(workload->a, workload->b,
+				- ZONE_WIDTH / 2, - ZONE_HEIGHT / 2, ZONE_WIDTH, ZONE_HEIGHT);
+	case FIGURE_BEZIER:
+		return get_bezier_figure(workload->points);
+	case FIGURE_HERMIT:
+		return get_hermitian_figure(workload->points);
+	case FIGURE_B_SPLINE:
+		return get_b_spline_figure(workload->points);
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+// Builds the figures of one run and frees them, returns their size
+static guint
+build_figures(Workload *workload)
+{
+	GArray *figure;
+	GArray **figures;
+	guint i, pixels;
+
+	if (workload->type != FIGURE_DDA_LINE_BATCH && workload->type != FIGURE_BRESENHAM_LINE_BATCH) {
+		figure = build_figure(workload);
+		pixels = figure->len;
+		figure_free(figure);
+
+		return pixels;
+	}
+
+	figures = g_new(GArray *, workload->n_segments);
+
+	if (workload->type == FIGURE_DDA_LINE_BATCH) {
+		get_dda_line_figures(workload->segments, workload->n_segments, figures);
+	} else {
+		get_bresenham_line_figures(workload->segments, workload->n_segments, figures);
+	}
+
+	pixels = 0;
+	for (i = 0; i < workload->n_segments; ++i) {
+		pixels += figures[i]->len;
+		figure_free(figures[i]);
+	}
+
+	g_free(figures);
+
+	return pixels;
+}
+
+static void
+run_workload(Workload *workload, gdouble min_time, gboolean is_first)
+{
+	guint pixels;
+	guint64 iterations, total_pixels;
+	gint64 start, elapsed;
+	gdouble ns_per_pixel, pixels_per_sec;
+
+	alloc_stats.allocations = 0;
+	alloc_stats.current_bytes = 0;
+	alloc_stats.peak_bytes = 0;
+
+	alloc_stats.tracking = TRUE;
+	pixels = build_figures(workload);
+	alloc_stats.tracking = FALSE;
+
+	iterations = 0;
+	total_pixels = 0;
+	start = g_get_monotonic_time();
+
+	do {
+		total_pixels += build_figures(workload);
+
+		++iterations;
+		elapsed = g_get_monotonic_time() - start;
+	} while (elapsed < min_time * G_USEC_PER_SEC);
+
+	ns_per_pixel = total_pixels > 0 ? elapsed * 1000.0 / total_pixels : 0;
+	pixels_per_sec = elapsed > 0 ? total_pixels * (gdouble) G_USEC_PER_SEC / elapsed : 0;
+
+	printf("%s\n    {\"figure\": \"%s\", \"params\": {%s}, \"iterations\": %" G_GUINT64_FORMAT
+			", \"pixels\": %u, \"ns_per_figure\": %.1f, \"ns_per_pixel\": %.3f"
+			", \"pixels_per_sec\": %.0f, \"allocations\": %" G_GUINT64_FORMAT
+			", \"peak_bytes\": %" G_GINT64_FORMAT "}",
+			is_first ? "" : ",",
+			figure_names[workload->type],
+			workload->params,
+			iterations,
+			pixels,
+			elapsed * 1000.0 / iterations,
+			ns_per_pixel,
+			pixels_per_sec,
+			alloc_stats.allocations,
+			alloc_stats.peak_bytes);
+}
+
+static void
+add_line_workloads(GPtrArray *workloads, gint length)
+{
+	static const gint octants[8][2] = {
+		{2, 1}, {1, 2}, {-1, 2}, {-2, 1},
+		{-2, -1}, {-1, -2}, {1, -2}, {2, -1}
+	};
+	FigureType type;
+	Workload *workload;
+	gint i;
+
+	for (type = FIGURE_DDA_LINE; type <= FIGURE_WU_LINE; ++type) {
+		for (i = 0; i < 8; ++i) {
+			workload = g_new0(Workload, 1);
+			workload->type = type;
+			workload->x2 = octants[i][0] * length / 2;
+			workload->y2 = octants[i][1] * length / 2;
+			workload->params = g_strdup_printf("\"length\": %d, \"octant\": %d", length, i);
+			g_ptr_array_add(workloads, workload);
+		}
+	}
+}
+
+// count lines of the given length in all octants, in one call
+static void
+add_line_batch_workloads(GPtrArray *workloads, guint count, gint length)
+{
+	static const gint octants[8][2] = {
+		{2, 1}, {1, 2}, {-1, 2}, {-2, 1},
+		{-2, -1}, {-1, -2}, {1, -2}, {2, -1}
+	};
+	FigureType type;
+	Workload *workload;
+	guint i;
+
+	for (type = FIGURE_DDA_LINE_BATCH; type <= FIGURE_BRESENHAM_LINE_BATCH; ++type) {
+		workload = g_new0(Workload, 1);
+		workload->type = type;
+		workload->n_segments = count;
+		workload->segments = g_new0(Segment, count);
+
+		for (i = 0; i < count; ++i) {
+			workload->segments[i].x1 = i % 100;
+			workload->segments[i].y1 = i / 100 % 100;
+			workload->segments[i].x2 = workload->segments[i].x1 + octants[i % 8][0] * length / 2;
+			workload->segments[i].y2 = workload->segments[i].y1 + octants[i % 8][1] * length / 2;
+		}
+
+		workload->params = g_strdup_printf("\"count\": %u, \"length\": %d", count, length);
+		g_ptr_array_add(workloads, workload);
+	}
+}
+
+static void
+add_conic_workloads(GPtrArray *workloads)
+{
+	static const gint sizes[] = {1, 10, 100, 1000, 10000};
+	FigureType type;
+	Workload *workload;
+	guint i, j;
+
+	for (type = FIGURE_ELLIPSE; type <= FIGURE_HYPERBOLE; ++type) {
+		for (i = 0; i < G_N_ELEMENTS(sizes); ++i) {
+			for (j = 0; j < G_N_ELEMENTS(sizes); ++j) {
+				workload = g_new0(Workload, 1);
+				workload->type = type;
+				workload->a = sizes[i];
+				workload->b = sizes[j];
+				workload->params = g_strdup_printf("\"a\": %d, \"b\": %d", sizes[i], sizes[j]);
+				g_ptr_array_add(workloads, workload);
+			}
+		}
+	}
+}
+
+static GList *
+get_control_points(gint n, gint span)
+{
+	GList *points;
+	Point *point;
+	gint i;
+
+	points = NULL;
+
+	for (i = 0; i < n; ++i) {
+		point = g_malloc(sizeof(Point));
+		point->x = i * span / MAX(n - 1, 1) - span / 2;
+		point->y = (i % 2 == 0 ? -1 : 1) * span / 4;
+		points = g_list_prepend(points, point);
+	}
+
+	return g_list_reverse(points);
+}
+
+static void
+add_curve_workloads(GPtrArray *workloads)
+{
+	static const gint spans[] = {20, 2000, 20000};
+	static const gint spline_sizes[] = {4, 64, 1024};
+	FigureType type;
+	Workload *workload;
+	guint j, k;
+
+	for (type = FIGURE_BEZIER; type <= FIGURE_B_SPLINE; ++type) {
+		for (j = 0; j < G_N_ELEMENTS(spans); ++j) {
+			for (k = 0; k < G_N_ELEMENTS(spline_sizes); ++k) {
+				if (type != FIGURE_B_SPLINE && k > 0) {
+					break;
+				}
+
+				workload = g_new0(Workload, 1);
+				workload->type = type;
+				workload->points = get_control_points(spline_sizes[k], spans[j]);
+				workload->params = g_strdup_printf("\"span\": %d, \"points\": %d",
+						spans[j], spline_sizes[k]);
+				g_ptr_array_add(workloads, workload);
+			}
+		}
+	}
+}
+
+static void
+free_workload(gpointer data)
+{
+	Workload *workload = data;
+
+	g_list_free_full(workload->points, g_free);
+	g_free(workload->segments);
+	g_free(workload->params);
+	g_free(workload);
+}
+
+int
+main(int argc, char *argv[])
+{
+	GPtrArray *workloads;
+	gdouble min_time;
+	guint i;
+
+	min_time = argc > 1 ? g_ascii_strtod(argv[1], NULL) : DEFAULT_MIN_TIME;
+	if (min_time <= 0) {
+		min_time = DEFAULT_MIN_TIME;
+	}
+
+	workloads = g_ptr_array_new_with_free_func(free_workload);
+
+	add_line_workloads(workloads, 10);
+	add_line_workloads(workloads, 5000);
+	add_line_batch_workloads(workloads, 10000, 10);
+	add_line_batch_workloads(workloads, 100, 5000);
+	add_conic_workloads(workloads);
+	add_curve_workloads(workloads);
+
+	printf("{\n  \"min_time\": %g,\n  \"benchmarks\": [", min_time);
+	for (i = 0; i < workloads->len; ++i) {
+		run_workload(g_ptr_array_index(workloads, i), min_time, i == 0);
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	g_ptr_array_unref(workloads);
+
+	return 0;
+}
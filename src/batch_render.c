@@ -0,0 +1,153 @@
+#include "batch_render.h"
+#include "document.h"
+#include "import.h"
+#include "png_export.h"
+
+#include <string.h>
+
+typedef struct _BatchRenderOptions BatchRenderOptions;
+struct _BatchRenderOptions {
+	gchar *input, *output;
+	gchar *kind_name;
+	gint width, height;
+	gint cell_size;
+};
+
+static gboolean parse_options(gint argc, gchar **argv, BatchRenderOptions *options, GError **error);
+static gboolean render(const BatchRenderOptions *options, GError **error);
+
+gboolean
+batch_render_requested(gint argc, gchar **argv)
+{
+	gint i;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--render") == 0 || g_str_has_prefix(argv[i], "--render=")) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+parse_options(gint argc, gchar **argv, BatchRenderOptions *options, GError **error)
+{
+	GOptionContext *context;
+	gboolean result;
+	GOptionEntry entries[] = {
+		{"render", 0, 0, G_OPTION_ARG_FILENAME, &options->input,
+				"Render a drawing or a figure file without a window", "FILE"},
+		{"output", 'o', 0, G_OPTION_ARG_FILENAME, &options->output, "PNG image to write", "FILE"},
+		{"width", 0, 0, G_OPTION_ARG_INT, &options->width,
+				"Canvas width in cells, the drawing's or 800 by default", "N"},
+		{"height", 0, 0, G_OPTION_ARG_INT, &options->height,
+				"Canvas height in cells, the drawing's or 600 by default", "N"},
+		{"zoom", 0, 0, G_OPTION_ARG_INT, &options->cell_size, "Pixels per cell, 1 by default", "N"},
+		{"kind", 0, 0, G_OPTION_ARG_STRING, &options->kind_name,
+				"Kind of the figures given without one, bresenham by default", "NAME"},
+		{NULL}
+	};
+
+	context = g_option_context_new("- render a drawing to a PNG image");
+	g_option_context_add_main_entries(context, entries, NULL);
+	result = g_option_context_parse(context, &argc, &argv, error);
+	g_option_context_free(context);
+
+	if (result && argc > 1) {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, "Unexpected argument %s", argv[1]);
+		result = FALSE;
+	}
+
+	if (result && options->output == NULL) {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, "No output image, use -o FILE");
+		result = FALSE;
+	}
+
+	return result;
+}
+
+static gboolean
+render(const BatchRenderOptions *options, GError **error)
+{
+	Scene *scene;
+	SceneKind kind;
+	gchar *lower_name;
+	gboolean is_document, result;
+	gint width, height;
+
+	kind = SCENE_KIND_BRESENHAM_LINE;
+	if (options->kind_name != NULL) {
+		kind = scene_kind_from_name(options->kind_name, strlen(options->kind_name));
+		if (kind == SCENE_KIND_NONE) {
+			g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+					"Unknown figure kind %s", options->kind_name);
+			return FALSE;
+		}
+	}
+
+	if (options->cell_size <= 0) {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "The zoom must be positive");
+		return FALSE;
+	}
+
+	lower_name = g_ascii_strdown(options->input, -1);
+	is_document = g_str_has_suffix(lower_name, ".ged");
+	g_free(lower_name);
+
+	width = BATCH_RENDER_DEFAULT_WIDTH;
+	height = BATCH_RENDER_DEFAULT_HEIGHT;
+
+	if (is_document) {
+		scene = document_load(options->input, &width, &height, error);
+		if (scene == NULL) {
+			return FALSE;
+		}
+	} else {
+		scene = scene_new();
+		if (!import_file(scene, options->input, kind, NULL, error)) {
+			scene_free(scene);
+			return FALSE;
+		}
+	}
+
+	width = options->width != 0 ? options->width : width;
+	height = options->height != 0 ? options->height : height;
+
+	if (width <= 0 || width > DOCUMENT_MAX_SIZE || height <= 0 || height > DOCUMENT_MAX_SIZE) {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+				"The canvas size must be from 1 to %d", DOCUMENT_MAX_SIZE);
+		result = FALSE;
+	} else {
+		result = png_export(scene, width, height, options->cell_size, options->output, error);
+	}
+
+	scene_free(scene);
+
+	return result;
+}
+
+gint
+batch_render_main(gint argc, gchar **argv)
+{
+	BatchRenderOptions options;
+	GError *error;
+	gboolean result;
+
+	memset(&options, 0, sizeof(options));
+	options.cell_size = 1;
+
+	error = NULL;
+	result = parse_options(argc, argv, &options, &error) && render(&options, &error);
+
+	if (!result) {
+		g_printerr("%s: %s\n", g_get_prgname() != NULL ? g_get_prgname() : argv[0], error->message);
+		g_error_free(error);
+	}
+
+	g_free(options.input);
+	g_free(options.output);
+	g_free(options.kind_name);
+
+	return result ? 0 : 1;
+}
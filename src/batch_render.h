@@ -0,0 +1,29 @@
+#ifndef __BATCH_RENDER_H
+#define __BATCH_RENDER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Command line rendering without a display:
+ *
+ *   graphics_editor --render scene.txt -o out.png [--width N] [--height N] [--zoom N] [--kind NAME]
+ *
+ * The input is a drawing (*.ged) or a figure file in the import format,
+ * one figure per line, such as "bresenham 0 0 100 50" or
+ * "b-spline 0 0 10 20 30 0". The PNG image is written by png_export().
+ */
+
+#define BATCH_RENDER_DEFAULT_WIDTH 800
+#define BATCH_RENDER_DEFAULT_HEIGHT 600
+
+/* TRUE if argv asks for --render */
+gboolean batch_render_requested(gint argc, gchar **argv);
+
+/* Parses argv and renders; returns the exit status of the program */
+gint batch_render_main(gint argc, gchar **argv);
+
+G_END_DECLS
+
+#endif /* __BATCH_RENDER_H */
@@ -0,0 +1,87 @@
+#include "command_log.h"
+
+struct _CommandLog {
+	GArray *commands; // Command
+	GArray *values; // gint values of all the commands, in order
+	guint position; // commands before it are done, the others undone
+};
+
+CommandLog *
+command_log_new(void)
+{
+	CommandLog *log;
+
+	log = g_malloc(sizeof(CommandLog));
+	log->commands = g_array_new(FALSE, FALSE, sizeof(Command));
+	log->values = g_array_new(FALSE, FALSE, sizeof(gint));
+	log->position = 0;
+
+	return log;
+}
+
+void
+command_log_free(CommandLog *log)
+{
+	g_array_free(log->commands, TRUE);
+	g_array_free(log->values, TRUE);
+	g_free(log);
+}
+
+void
+command_log_clear(CommandLog *log)
+{
+	g_array_set_size(log->commands, 0);
+	g_array_set_size(log->values, 0);
+	log->position = 0;
+}
+
+void
+command_log_push(CommandLog *log, const Command *command, const gint *values, guint n_values)
+{
+	Command *last;
+
+	// A new edit forgets what was undone
+	if (log->position < log->commands->len) {
+		last = &g_array_index(log->commands, Command, log->position);
+		g_array_set_size(log->values, last->first_value);
+		g_array_set_size(log->commands, log->position);
+	}
+
+	g_array_append_val(log->commands, *command);
+	last = &g_array_index(log->commands, Command, log->commands->len - 1);
+	last->first_value = log->values->len;
+	last->n_values = n_values;
+	g_array_append_vals(log->values, values, n_values);
+
+	log->position = log->commands->len;
+}
+
+const Command *
+command_log_undo(CommandLog *log)
+{
+	if (log->position == 0) {
+		return NULL;
+	}
+
+	--log->position;
+
+	return &g_array_index(log->commands, Command, log->position);
+}
+
+const Command *
+command_log_redo(CommandLog *log)
+{
+	if (log->position == log->commands->len) {
+		return NULL;
+	}
+
+	++log->position;
+
+	return &g_array_index(log->commands, Command, log->position - 1);
+}
+
+const gint *
+command_log_get_values(CommandLog *log, const Command *command)
+{
+	return &g_array_index(log->values, gint, command->first_value);
+}
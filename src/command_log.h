@@ -0,0 +1,54 @@
+#ifndef __COMMAND_LOG_H
+#define __COMMAND_LOG_H
+
+#include "scene.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Undo history: an append-only log of the edits of a scene. Commands
+ * keep only what changed, so a step costs a few dozen bytes plus the
+ * parameters or points of the items it added or removed. Items are known
+ * by their scene ids, which undo and redo get back as they replay the
+ * commands in order.
+ */
+typedef struct _CommandLog CommandLog;
+
+typedef enum {
+	COMMAND_ADD_ITEM, // a figure or a spline with its values
+	COMMAND_REMOVE_ITEM,
+	COMMAND_MOVE_POINT,
+	COMMAND_DELETE_POINT, // of a B-spline
+	COMMAND_JOIN_SPLINES, // B-spline tail_id appended to id
+	COMMAND_IMPORT_ITEMS // index items: their ids, then the kind, number and values of each
+} CommandType;
+
+typedef struct _Command Command;
+struct _Command {
+	CommandType type;
+	SceneKind kind; // of an added or removed item
+	guint id; // the item changed
+	guint tail_id; // joined splines: the spline appended to id, then removed
+	guint index; // the moved or deleted point; joined splines: points of id before; imported items
+	gint x, y; // the moved point before, the deleted point
+	gint to_x, to_y; // the moved point after
+	gboolean reverse_head, reverse_tail; // joined splines reversed before joining
+	guint first_value, n_values; // parameters or point coordinates of an item
+};
+
+CommandLog *command_log_new(void);
+void command_log_free(CommandLog *log);
+void command_log_clear(CommandLog *log);
+
+/* Appends command and its n_values values, dropping the undone commands */
+void command_log_push(CommandLog *log, const Command *command, const gint *values, guint n_values);
+
+/* The command to undo or to redo, which becomes the current one; NULL if none */
+const Command *command_log_undo(CommandLog *log);
+const Command *command_log_redo(CommandLog *log);
+
+const gint *command_log_get_values(CommandLog *log, const Command *command);
+
+G_END_DECLS
+
+#endif /* __COMMAND_LOG_H */
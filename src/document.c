@@ -0,0 +1,330 @@
+#include "document.h"
+#include <string.h>
+
+#define DOCUMENT_MAGIC "GRAPHEDT"
+#define DOCUMENT_VERSION 1
+#define DOCUMENT_BYTE_ORDER 0x01020304
+#define DOCUMENT_ALIGNMENT 8
+
+typedef struct _DocumentHeader DocumentHeader;
+struct _DocumentHeader {
+	gchar magic[8];
+	guint32 version;
+	guint32 byte_order; // DOCUMENT_BYTE_ORDER as written by the saving machine
+	gint32 width, height;
+	guint32 n_sections; // number of DocumentSection right after the header
+	guint32 reserved;
+};
+
+/*
+ * count items of one kind. Figures are count records of the parameters
+ * of the kind at offset. Splines are count + 1 indexes of their first
+ * points at offset, the last one being n_points, and n_points x, y
+ * pairs at points_offset. All offsets are from the start of the file.
+ */
+typedef struct _DocumentSection DocumentSection;
+struct _DocumentSection {
+	guint32 kind;
+	guint32 count;
+	guint64 offset;
+	guint64 n_points;
+	guint64 points_offset;
+};
+
+typedef struct _SectionData SectionData;
+struct _SectionData {
+	GArray *values; // gint32 parameters or point coordinates
+	GArray *starts; // guint32 indexes of the first points, for splines
+};
+
+static void collect_item(guint id, SceneItem *item, gpointer user_data);
+static guint64 append_aligned(GByteArray *body, guint64 base, gconstpointer data, gsize size);
+static gboolean check_header(const gchar *data, gsize size, GError **error);
+static gboolean check_section(const DocumentSection *section, gsize size, const gchar *data);
+static void load_section(Scene *scene, const DocumentSection *section, const gchar *data);
+
+G_DEFINE_QUARK(document-error-quark, document_error)
+
+static void
+collect_item(guint id, SceneItem *item, gpointer user_data)
+{
+	SectionData *section_data = user_data;
+	Figure *figure;
+	Point *point;
+	GList *link;
+	gint32 coordinates[2];
+	guint32 start;
+
+	if (section_data->starts == NULL) {
+		figure = g_ptr_array_index(item->segments, 0);
+		g_array_append_vals(section_data->values, figure->params, scene_kinds[item->kind].n_params);
+		return;
+	}
+
+	for (link = item->points; link != NULL; link = g_list_next(link)) {
+		point = link->data;
+		coordinates[0] = point->x;
+		coordinates[1] = point->y;
+		g_array_append_vals(section_data->values, coordinates, 2);
+	}
+
+	start = section_data->values->len / 2;
+	g_array_append_val(section_data->starts, start);
+}
+
+// Appends data at the next aligned offset, base being the offset of
+// the body in the file. Returns the offset of data in the file
+static guint64
+append_aligned(GByteArray *body, guint64 base, gconstpointer data, gsize size)
+{
+	static const guint8 padding[DOCUMENT_ALIGNMENT] = {0};
+	guint64 offset;
+
+	g_byte_array_append(body, padding, (DOCUMENT_ALIGNMENT - body->len % DOCUMENT_ALIGNMENT) % DOCUMENT_ALIGNMENT);
+	offset = base + body->len;
+	g_byte_array_append(body, data, size);
+
+	return offset;
+}
+
+gboolean
+document_save(Scene *scene, gint width, gint height, const gchar *filename, GError **error)
+{
+	SectionData section_data[SCENE_N_KINDS], *data;
+	DocumentSection sections[SCENE_N_KINDS];
+	DocumentHeader header;
+	GByteArray *body, *file;
+	SceneKind kind;
+	guint64 base;
+	guint32 start;
+	guint n_sections, i;
+	gboolean result;
+
+	g_return_val_if_fail(width > 0 && width <= DOCUMENT_MAX_SIZE, FALSE);
+	g_return_val_if_fail(height > 0 && height <= DOCUMENT_MAX_SIZE, FALSE);
+
+	n_sections = 0;
+	for (kind = SCENE_KIND_NONE + 1; kind < SCENE_N_KINDS; ++kind) {
+		section_data[kind].values = g_array_new(FALSE, FALSE, sizeof(gint32));
+		section_data[kind].starts = NULL;
+
+		if (scene_kinds[kind].get_segment_count != NULL) {
+			start = 0;
+			section_data[kind].starts = g_array_new(FALSE, FALSE, sizeof(guint32));
+			g_array_append_val(section_data[kind].starts, start);
+		}
+
+		scene_foreach(scene, kind, collect_item, &section_data[kind]);
+
+		if (section_data[kind].values->len > 0) {
+			sections[n_sections].kind = kind;
+			++n_sections;
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DOCUMENT_MAGIC, sizeof(header.magic));
+	header.version = DOCUMENT_VERSION;
+	header.byte_order = DOCUMENT_BYTE_ORDER;
+	header.width = width;
+	header.height = height;
+	header.n_sections = n_sections;
+
+	body = g_byte_array_new();
+	base = sizeof(DocumentHeader) + n_sections * sizeof(DocumentSection);
+
+	for (i = 0; i < n_sections; ++i) {
+		data = &section_data[sections[i].kind];
+		if (data->starts == NULL) {
+			sections[i].count = data->values->len / scene_kinds[sections[i].kind].n_params;
+			sections[i].offset = append_aligned(body, base, data->values->data,
+					data->values->len * sizeof(gint32));
+			sections[i].n_points = 0;
+			sections[i].points_offset = 0;
+		} else {
+			sections[i].count = data->starts->len - 1;
+			sections[i].offset = append_aligned(body, base, data->starts->data,
+					data->starts->len * sizeof(guint32));
+			sections[i].n_points = data->values->len / 2;
+			sections[i].points_offset = append_aligned(body, base, data->values->data,
+					data->values->len * sizeof(gint32));
+		}
+	}
+
+	for (kind = SCENE_KIND_NONE + 1; kind < SCENE_N_KINDS; ++kind) {
+		g_array_free(section_data[kind].values, TRUE);
+		if (section_data[kind].starts != NULL) {
+			g_array_free(section_data[kind].starts, TRUE);
+		}
+	}
+
+	file = g_byte_array_sized_new(base + body->len);
+	g_byte_array_append(file, (const guint8 *) &header, sizeof(header));
+	g_byte_array_append(file, (const guint8 *) sections, n_sections * sizeof(DocumentSection));
+	g_byte_array_append(file, body->data, body->len);
+	g_byte_array_free(body, TRUE);
+
+	result = g_file_set_contents(filename, (const gchar *) file->data, file->len, error);
+	g_byte_array_free(file, TRUE);
+
+	return result;
+}
+
+static gboolean
+check_header(const gchar *data, gsize size, GError **error)
+{
+	const DocumentHeader *header = (const DocumentHeader *) data;
+
+	if (size < sizeof(DocumentHeader) || memcmp(header->magic, DOCUMENT_MAGIC, sizeof(header->magic)) != 0) {
+		g_set_error(error, DOCUMENT_ERROR, DOCUMENT_ERROR_FORMAT, "The file is not a drawing");
+		return FALSE;
+	}
+
+	if (header->byte_order != DOCUMENT_BYTE_ORDER || header->version > DOCUMENT_VERSION) {
+		g_set_error(error, DOCUMENT_ERROR, DOCUMENT_ERROR_VERSION,
+				"The drawing was saved by a newer version or on another kind of machine");
+		return FALSE;
+	}
+
+	if (header->width <= 0 || header->width > DOCUMENT_MAX_SIZE
+			|| header->height <= 0 || header->height > DOCUMENT_MAX_SIZE
+			|| header->n_sections > (size - sizeof(DocumentHeader)) / sizeof(DocumentSection)) {
+		g_set_error(error, DOCUMENT_ERROR, DOCUMENT_ERROR_FORMAT, "The drawing is damaged");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// Every record of the section lies in the file and holds a figure or
+// a spline the importer would take
+static gboolean
+check_section(const DocumentSection *section, gsize size, const gchar *data)
+{
+	const gint32 *values, *coordinates;
+	const guint32 *starts;
+	gint n_params;
+	guint i;
+
+	if (section->kind <= SCENE_KIND_NONE || section->kind >= SCENE_N_KINDS
+			|| section->offset % sizeof(gint32) != 0 || section->offset > size) {
+		return FALSE;
+	}
+
+	if (scene_kinds[section->kind].get_segment_count == NULL) {
+		n_params = scene_kinds[section->kind].n_params;
+		if ((guint64) section->count * n_params * sizeof(gint32) > size - section->offset) {
+			return FALSE;
+		}
+
+		values = (const gint32 *) (data + section->offset);
+		for (i = 0; i < section->count; ++i) {
+			if (scene_check_values(section->kind, values + i * n_params, n_params) != NULL) {
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	if (((guint64) section->count + 1) * sizeof(guint32) > size - section->offset
+			|| section->points_offset % sizeof(gint32) != 0 || section->points_offset > size
+			|| section->n_points > (size - section->points_offset) / (2 * sizeof(gint32))) {
+		return FALSE;
+	}
+
+	starts = (const guint32 *) (data + section->offset);
+	if (starts[0] != 0 || starts[section->count] != section->n_points) {
+		return FALSE;
+	}
+
+	coordinates = (const gint32 *) (data + section->points_offset);
+	for (i = 0; i < section->count; ++i) {
+		if (starts[i + 1] <= starts[i] || scene_check_values(section->kind,
+				coordinates + 2 * starts[i], 2 * (starts[i + 1] - starts[i])) != NULL) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+load_section(Scene *scene, const DocumentSection *section, const gchar *data)
+{
+	const gint32 *values, *coordinates;
+	const guint32 *starts;
+	GList *points;
+	Point *point;
+	gint n_params;
+	guint i, j;
+
+	values = (const gint32 *) (data + section->offset);
+
+	if (scene_kinds[section->kind].get_segment_count == NULL) {
+		n_params = scene_kinds[section->kind].n_params;
+		for (i = 0; i < section->count; ++i) {
+			scene_add_figure(scene, section->kind, values + i * n_params);
+		}
+		return;
+	}
+
+	starts = (const guint32 *) values;
+	coordinates = (const gint32 *) (data + section->points_offset);
+
+	for (i = 0; i < section->count; ++i) {
+		points = NULL;
+		for (j = starts[i + 1]; j-- > starts[i];) {
+			point = g_malloc(sizeof(Point));
+			point->x = coordinates[2 * j];
+			point->y = coordinates[2 * j + 1];
+			points = g_list_prepend(points, point);
+		}
+
+		scene_add_spline(scene, section->kind, points);
+	}
+}
+
+Scene *
+document_load(const gchar *filename, gint *width, gint *height, GError **error)
+{
+	const DocumentHeader *header;
+	const DocumentSection *sections;
+	GMappedFile *file;
+	const gchar *data;
+	Scene *scene;
+	gsize size;
+	guint i;
+
+	file = g_mapped_file_new(filename, FALSE, error);
+	if (file == NULL) {
+		return NULL;
+	}
+
+	data = g_mapped_file_get_contents(file);
+	size = g_mapped_file_get_length(file);
+	scene = NULL;
+
+	if (check_header(data, size, error)) {
+		header = (const DocumentHeader *) data;
+		sections = (const DocumentSection *) (header + 1);
+
+		for (i = 0; i < header->n_sections && check_section(&sections[i], size, data); ++i);
+
+		if (i < header->n_sections) {
+			g_set_error(error, DOCUMENT_ERROR, DOCUMENT_ERROR_FORMAT, "The drawing is damaged");
+		} else {
+			scene = scene_new();
+			for (i = 0; i < header->n_sections; ++i) {
+				load_section(scene, &sections[i], data);
+			}
+
+			*width = header->width;
+			*height = header->height;
+		}
+	}
+
+	g_mapped_file_unref(file);
+
+	return scene;
+}
@@ -0,0 +1,36 @@
+#ifndef __DOCUMENT_H
+#define __DOCUMENT_H
+
+#include "scene.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Drawings on disk. Figures are stored by their parameters, one section
+ * of fixed-size records per kind; splines store their control points.
+ * A document is loaded from a memory map of the file without parsing
+ * any text, and its figures are only rasterized when first drawn.
+ *
+ * Documents use the byte order of the machine that saved them.
+ */
+
+#define DOCUMENT_MAX_SIZE 32767
+
+#define DOCUMENT_ERROR (document_error_quark())
+
+typedef enum {
+	DOCUMENT_ERROR_FORMAT, // not a document, or a damaged one
+	DOCUMENT_ERROR_VERSION // saved by a newer version or on another machine
+} DocumentError;
+
+GQuark document_error_quark(void);
+
+/* width and height are the canvas size, at most DOCUMENT_MAX_SIZE */
+gboolean document_save(Scene *scene, gint width, gint height, const gchar *filename, GError **error);
+
+/* Returns NULL and sets error if the file cannot be loaded */
+Scene *document_load(const gchar *filename, gint *width, gint *height, GError **error);
+
+G_END_DECLS
+
+#endif /* __DOCUMENT_H */
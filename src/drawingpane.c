@@ -1,22 +1,45 @@
 #include "drawingpane.h"
 #include "drawingpane_utils.h"
 #include "graphicseditor_utils.h"
+#include "command_log.h"
+#include "document.h"
+#include "import.h"
+#include "png_export.h"
+#include "spatial_grid.h"
+#include "tile_cache.h"
 
 #include <math.h>
+#include <string.h>
 
-#define STEP 0.001
+#define FIGURE_GRID_CELL_SIZE 32
+#define POINT_GRID_CELL_SIZE 16
+#define TILE_SIZE 256
+#define TILE_CACHE_BUDGET (64 << 20)
 
 typedef struct _Color Color;
 struct _Color {
     gdouble r, g, b;
 };
 
-typedef struct _Spline Spline;
-struct _Spline
-{
-    GList *points;
-    GList *pixels;
-    gboolean need_refresh_pixels;
+// Snapshot of the pane shared by the tiles rendered in one draw
+typedef struct _TileBatch TileBatch;
+struct _TileBatch {
+	const guchar *figures;
+	gint stride;
+	gint width, height;
+	gint cell_size;
+	gint area_width, area_height;
+
+	gint pending;
+	GMutex mutex;
+	GCond done;
+};
+
+typedef struct _TileJob TileJob;
+struct _TileJob {
+	TileBatch *batch;
+	cairo_surface_t *tile;
+	gint tx, ty;
 };
 
 struct _DrawingPanePrivate
@@ -39,19 +62,36 @@ struct _DrawingPanePrivate
 
 	GList *created_points;
 
-	GList *figure_list; // static figures(1st/2nd order lines)
-	GList *bezier_forms;
-	GList *hermitian_forms;
-    GList *b_spliens;
+	Scene *scene; // all figures and splines
 
     Point *old_point;
-    Spline *move_spline;
+    guint move_spline; // scene id of the spline of old_point, 0 if none
+    Point drag_origin; // old_point before it was dragged
+    gint drag_x, drag_y; // where old_point goes on the next frame
+    guint drag_tick; // pending tick callback applying the drag, 0 if none
+
+	cairo_surface_t *figures_surface;
+	cairo_region_t *figures_damage; // cells of figures_surface to redraw
+	SpatialGrid *figure_grid; // bounding boxes of all committed figures
+	SpatialGrid *point_grid; // control points of all splines
+	GHashTable *point_splines; // Point -> scene id of its spline
+
+	CommandLog *history; // edits of the scene, for undo and redo
+
+	TileCache *tiles; // rendered TILE_SIZE squares of the widget, per cell_size
+	GThreadPool *tile_pool;
 };
 
 enum {
 	PROP_CUR_X = 1, PROP_CUR_Y
 };
 
+enum {
+	CURSOR_CHANGED, LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
 static Color red_color = {1, 0, 0};
 static Color green_color = {0, 1, 0};
 static Color blue_color = {0, 0, 1};
@@ -67,21 +107,32 @@ static gboolean drawing_area_configure_event_handler (GtkWidget *widget, GdkEven
 static gboolean drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *event, gpointer data);
 static gboolean drawing_area_motion_notify_event_handler (GtkWidget *widget, GdkEventMotion  *event, gpointer data);
 static gboolean drawing_area_button_release_event_handler(GtkWidget *widget, GdkEventButton *event, gpointer data);
-static void draw_pixel(cairo_t *cr, Pixel *pixel, DrawingPane *pane);
-static void draw_figure(cairo_t *cr, GList *figure, DrawingPane *pane);
+static void draw_figure(Figure *figure, const cairo_rectangle_int_t *clip, DrawingPane *pane);
+static void invalidate_point(DrawingPane *pane, Point *point);
+static void damage_figure(DrawingPane *pane, Figure *figure);
+static void invalidate_tiles(DrawingPane *pane, const cairo_rectangle_int_t *cells);
+static void render_tile(gpointer data, gpointer user_data);
+static void index_figure(DrawingPane *pane, Figure *figure);
+static void index_item(guint id, SceneItem *item, gpointer user_data);
+static void unindex_item(guint id, SceneItem *item, gpointer user_data);
+static void invalidate_canvas(DrawingPane *pane);
+static void unindex_figure(DrawingPane *pane, Figure *figure);
+static void commit_figure(DrawingPane *pane, Figure *figure);
+static void repair_figures_surface(DrawingPane *pane, const cairo_rectangle_int_t *visible_rect);
 static void translate(DrawingPane *pane, gint *x, gint *y);
 static void clear_list(GList **figure);
 static GraphicsEditorDrawingModeType get_drawing_mode(DrawingPane *pane);
 static gboolean is_line_drawing_mode(GraphicsEditorDrawingModeType mode);
-static GList *get_line_figure(GraphicsEditorDrawingModeType drawing_mode, gint x1, gint y1, gint x2, gint y2);
-static GList *get_hyperbole(DrawingPane *pane);
-static GList *get_ellipse(DrawingPane *pane);
-static void draw_net(cairo_t* cr, DrawingPane *pane);
-static void draw_coordinate_axis(cairo_t *cr, DrawingPane *pane);
+static SceneKind get_line_kind(GraphicsEditorDrawingModeType drawing_mode);
+static gboolean get_hyperbole(DrawingPane *pane, gint *params);
+static gboolean get_ellipse(DrawingPane *pane, gint *params);
+static void draw_coordinate_axis(cairo_t *cr, gint width, gint height, gint cell_size);
 static void draw_point(cairo_t *cr, Point *point, Color color, DrawingPane *pane);
+static void stop_drag(DrawingPane *pane);
 static void draw_key_points(cairo_t *cr, GList *list, Color color, DrawingPane *pane);
-static void get_nearest_point_to(gint x, gint y, DrawingPane *pane, GList *splines, Spline **out_spline, Point **out_point);
-static gboolean is_point_boundary(Point *point, Spline *spline);
+static void get_nearest_point_to(gint x, gint y, DrawingPane *pane, SceneKind kind, Point *skip,
+		guint *out_spline, Point **out_point);
+static gboolean is_point_boundary(Point *point, SceneItem *spline);
 static void drawing_mode_changed(GObject *object, GParamSpec *param, gpointer data);
 
 G_DEFINE_TYPE_WITH_PRIVATE(DrawingPane, drawing_pane, GTK_TYPE_BIN)
@@ -150,13 +201,22 @@ drawing_pane_init (DrawingPane *pane)
 
 	pane->priv->created_points = NULL;
 
-	pane->priv->figure_list = NULL;
-    pane->priv->b_spliens = NULL;
-	pane->priv->bezier_forms = NULL;
-	pane->priv->hermitian_forms = NULL;
+	pane->priv->scene = scene_new();
 
-    pane->priv->move_spline = NULL;
+    pane->priv->move_spline = 0;
     pane->priv->old_point = NULL;
+    pane->priv->drag_tick = 0;
+
+	pane->priv->figures_surface = NULL;
+	pane->priv->figures_damage = cairo_region_create();
+	pane->priv->figure_grid = spatial_grid_new(FIGURE_GRID_CELL_SIZE);
+	pane->priv->point_grid = spatial_grid_new(POINT_GRID_CELL_SIZE);
+	pane->priv->point_splines = g_hash_table_new(NULL, NULL);
+
+	pane->priv->history = command_log_new();
+
+	pane->priv->tiles = tile_cache_new(TILE_CACHE_BUDGET, (GDestroyNotify) cairo_surface_destroy);
+	pane->priv->tile_pool = g_thread_pool_new(render_tile, NULL, g_get_num_processors(), FALSE, NULL);
 
 	pane->priv->cur_x = 0;
 	pane->priv->cur_y = 0;
@@ -191,6 +251,14 @@ drawing_pane_class_init (DrawingPaneClass *class)
 					G_MININT, G_MAXINT, 0,
 					G_PARAM_READWRITE));
 
+	// Emitted once with both coordinates when the cursor enters another
+	// cell, instead of notifying cursor-x and cursor-y separately
+	signals[CURSOR_CHANGED] = g_signal_new("cursor-changed",
+			G_TYPE_FROM_CLASS(class),
+			G_SIGNAL_RUN_LAST,
+			0, NULL, NULL, NULL,
+			G_TYPE_NONE, 2, G_TYPE_INT, G_TYPE_INT);
+
 	gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class),
 			"/by/jylilov/graphicseditor/drawing_pane.xml");
 
@@ -299,71 +367,1185 @@ drawing_pane_set_handlers(DrawingPane *pane)
 }
 
 static void
-drawing_mode_changed(GObject *object, GParamSpec *param, gpointer data) {
-	DrawingPanePrivate *priv;
+drawing_mode_changed(GObject *object, GParamSpec *param, gpointer data) {
+	DrawingPanePrivate *priv;
+
+	priv = DRAWING_PANE(data)->priv;
+
+	clear_list(&priv->created_points);
+	stop_drag(DRAWING_PANE(data));
+	priv->move_spline = 0;
+	priv->old_point = NULL;
+
+	gtk_widget_queue_draw(GTK_WIDGET(priv->drawing_area));
+}
+
+static void
+drawing_pane_finalize(GObject *obj)
+{
+	DrawingPanePrivate *priv;
+
+	priv = DRAWING_PANE(obj)->priv;
+
+	//TODO
+
+	if (priv->figures_surface != NULL) {
+		cairo_surface_destroy(priv->figures_surface);
+		priv->figures_surface = NULL;
+	}
+
+	cairo_region_destroy(priv->figures_damage);
+	scene_free(priv->scene);
+	spatial_grid_free(priv->figure_grid);
+	spatial_grid_free(priv->point_grid);
+	g_hash_table_unref(priv->point_splines);
+	command_log_free(priv->history);
+
+	g_thread_pool_free(priv->tile_pool, FALSE, TRUE);
+	tile_cache_free(priv->tiles);
+
+	if (G_OBJECT_CLASS (drawing_pane_parent_class)->finalize != NULL)
+		G_OBJECT_CLASS (drawing_pane_parent_class)->finalize (obj);
+}
+
+DrawingPane *
+drawing_pane_new (GraphicsEditorWindow *win)
+{
+	return drawing_pane_new_with_size(win, DRAWING_PANE_DEFAULT_WIDTH, DRAWING_PANE_DEFAULT_HEIGHT);
+}
+
+DrawingPane *
+drawing_pane_new_with_size (GraphicsEditorWindow *win, gint width, gint height)
+{
+	DrawingPane *pane = g_object_new(DRAWING_PANE_TYPE, NULL);
+
+	pane->priv->window = win;
+	pane->priv->width = width;
+	pane->priv->height = height;
+
+	g_signal_connect(pane->priv->window,
+			"notify::drawing-mode",
+			G_CALLBACK(drawing_mode_changed),
+			pane);
+
+	return pane;
+}
+
+static void
+bounds_to_canvas_rect(DrawingPane *pane, const Bounds *bounds, cairo_rectangle_int_t *rect)
+{
+	rect->x = bounds->x1 + pane->priv->width / 2;
+	rect->y = - bounds->y2 + pane->priv->height / 2;
+	rect->width = bounds->x2 - bounds->x1 + 1;
+	rect->height = bounds->y2 - bounds->y1 + 1;
+}
+
+// Queues a redraw of the widget area covering cells in bounds,
+// including the markers that may be drawn around key points there
+static void
+invalidate_cells(DrawingPane *pane, const Bounds *bounds)
+{
+	cairo_rectangle_int_t rect;
+	gint cell_size, margin;
+
+	cell_size = pane->priv->cell_size;
+	margin = MAX(5, cell_size) * 6 / 5 + 1;
+
+	bounds_to_canvas_rect(pane, bounds, &rect);
+
+	gtk_widget_queue_draw_area(GTK_WIDGET(pane->priv->drawing_area),
+			rect.x * cell_size - margin,
+			rect.y * cell_size - margin,
+			rect.width * cell_size + 2 * margin,
+			rect.height * cell_size + 2 * margin);
+}
+
+static void
+invalidate_point(DrawingPane *pane, Point *point)
+{
+	Bounds bounds = {point->x, point->y, point->x, point->y};
+
+	invalidate_cells(pane, &bounds);
+}
+
+static void
+invalidate_points(DrawingPane *pane, GList *points)
+{
+	while (points != NULL) {
+		invalidate_point(pane, points->data);
+		points = g_list_next(points);
+	}
+}
+
+// Marks the cells of figure in figures_surface as stale, e.g. before
+// the figure is changed or deleted
+static void
+damage_figure(DrawingPane *pane, Figure *figure)
+{
+	cairo_rectangle_int_t rect;
+
+	if (figure->is_empty) {
+		return;
+	}
+
+	bounds_to_canvas_rect(pane, &figure->bounds, &rect);
+	cairo_region_union_rectangle(pane->priv->figures_damage, &rect);
+	invalidate_tiles(pane, &rect);
+
+	invalidate_cells(pane, &figure->bounds);
+}
+
+// Writes figure straight into the data of figures_surface,
+// touching only cells inside clip. Figures are rasterized here
+// the first time they are drawn
+static void
+draw_figure(Figure *figure, const cairo_rectangle_int_t *clip, DrawingPane *pane) {
+	DrawingPanePrivate *priv;
+
+	priv = pane->priv;
+
+	draw_figure_on_buffer(scene_figure_get_pixels(figure),
+			cairo_image_surface_get_data(priv->figures_surface),
+			cairo_image_surface_get_stride(priv->figures_surface),
+			priv->width / 2, priv->height / 2,
+			clip->x, clip->y, clip->width, clip->height);
+}
+
+// New figures are blended over the cached surface right away,
+// only their own cells are redrawn
+static void
+commit_figure(DrawingPane *pane, Figure *figure)
+{
+	DrawingPanePrivate *priv;
+	cairo_rectangle_int_t rect;
+
+	priv = pane->priv;
+
+	if (figure->is_empty) {
+		return;
+	}
+
+	if (priv->figures_surface != NULL) {
+		rect.x = rect.y = 0;
+		rect.width = priv->width;
+		rect.height = priv->height;
+
+		cairo_surface_flush(priv->figures_surface);
+		draw_figure(figure, &rect, pane);
+
+		bounds_to_canvas_rect(pane, &figure->bounds, &rect);
+		cairo_surface_mark_dirty_rectangle(priv->figures_surface, rect.x, rect.y, rect.width, rect.height);
+	}
+
+	bounds_to_canvas_rect(pane, &figure->bounds, &rect);
+	invalidate_tiles(pane, &rect);
+
+	invalidate_cells(pane, &figure->bounds);
+}
+
+static Figure *
+new_segment(DrawingPane *pane, SceneItem *spline, guint index)
+{
+	Figure *figure;
+	gint params[SCENE_MAX_PARAMS];
+
+	scene_get_segment_params(spline, index, params);
+	figure = scene_figure_new(spline->kind, params);
+	index_figure(pane, figure);
+
+	return figure;
+}
+
+static void
+free_segment(DrawingPane *pane, Figure *figure)
+{
+	damage_figure(pane, figure);
+	unindex_figure(pane, figure);
+	scene_figure_free(figure);
+}
+
+// Replaces removed segments from first on with added segments
+// rasterized from the current points. The other segments are kept
+static void
+splice_spline(DrawingPane *pane, SceneItem *spline, guint first, guint removed, guint added)
+{
+	Figure *figure;
+	guint i;
+
+	for (i = 0; i < removed; ++i) {
+		free_segment(pane, g_ptr_array_index(spline->segments, first + i));
+	}
+	g_ptr_array_remove_range(spline->segments, first, removed);
+
+	for (i = 0; i < added; ++i) {
+		figure = new_segment(pane, spline, first + i);
+		g_ptr_array_insert(spline->segments, first + i, figure);
+		damage_figure(pane, figure);
+	}
+}
+
+// Segments [*first, *last] depend on the point with index k. Bezier and
+// Hermite curves have one segment that depends on all their points
+static void
+get_point_segments(SceneItem *spline, gint k, guint *first, guint *last)
+{
+	*last = MIN(k + 2, (gint) spline->segments->len - 1);
+	*first = MIN(MAX(k - 1, 0), (gint) *last);
+}
+
+static void
+index_point(DrawingPane *pane, guint id, Point *point)
+{
+	Bounds bounds = {point->x, point->y, point->x, point->y};
+
+	spatial_grid_insert(pane->priv->point_grid, point, &bounds);
+	g_hash_table_insert(pane->priv->point_splines, point, GUINT_TO_POINTER(id));
+}
+
+static void
+unindex_point(DrawingPane *pane, Point *point)
+{
+	Bounds bounds = {point->x, point->y, point->x, point->y};
+
+	spatial_grid_remove(pane->priv->point_grid, point, &bounds);
+	g_hash_table_remove(pane->priv->point_splines, point);
+}
+
+static guint
+create_spline(DrawingPane *pane, GList *points, SceneKind kind)
+{
+	SceneItem *spline;
+	Figure *figure;
+	GList *list;
+	guint id, i;
+
+	id = scene_add_spline(pane->priv->scene, kind, points);
+	spline = scene_get(pane->priv->scene, id);
+
+	for (list = points; list != NULL; list = g_list_next(list)) {
+		index_point(pane, id, list->data);
+	}
+
+	for (i = 0; i < spline->segments->len; ++i) {
+		figure = g_ptr_array_index(spline->segments, i);
+		index_figure(pane, figure);
+		commit_figure(pane, figure);
+	}
+
+	return id;
+}
+
+// Removes a figure or a spline with its points
+static void
+free_item(DrawingPane *pane, guint id)
+{
+	SceneItem *spline;
+	GList *list;
+
+	spline = scene_get(pane->priv->scene, id);
+
+	for (list = spline->points; list != NULL; list = g_list_next(list)) {
+		unindex_point(pane, list->data);
+	}
+
+	splice_spline(pane, spline, 0, spline->segments->len, 0);
+	invalidate_points(pane, spline->points);
+
+	scene_remove(pane->priv->scene, id);
+}
+
+static void
+reverse_spline(SceneItem *spline)
+{
+	gpointer *segments;
+	gpointer segment;
+	guint i, n;
+
+	spline->points = g_list_reverse(spline->points);
+
+	segments = spline->segments->pdata;
+	n = spline->segments->len;
+	for (i = 0; i < n / 2; ++i) {
+		segment = segments[i];
+		segments[i] = segments[n - 1 - i];
+		segments[n - 1 - i] = segment;
+	}
+}
+
+static void
+move_point(DrawingPane *pane, guint id, Point *point, gint x, gint y)
+{
+	SceneItem *spline;
+	guint first, last;
+
+	if (point->x == x && point->y == y) {
+		return;
+	}
+
+	invalidate_point(pane, point);
+	unindex_point(pane, point);
+
+	point->x = x;
+	point->y = y;
+
+	index_point(pane, id, point);
+	invalidate_point(pane, point);
+
+	spline = scene_get(pane->priv->scene, id);
+	get_point_segments(spline, g_list_index(spline->points, point), &first, &last);
+	splice_spline(pane, spline, first, last - first + 1, last - first + 1);
+}
+
+static void
+begin_drag(DrawingPane *pane)
+{
+	pane->priv->drag_origin = *pane->priv->old_point;
+}
+
+// Motion events only record the pointer, the dragged point follows it
+// once per frame
+static gboolean
+apply_drag(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer data)
+{
+	DrawingPanePrivate *priv;
+
+	priv = DRAWING_PANE(data)->priv;
+	priv->drag_tick = 0;
+
+	move_point(DRAWING_PANE(data), priv->move_spline, priv->old_point, priv->drag_x, priv->drag_y);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+queue_drag(DrawingPane *pane, gint x, gint y)
+{
+	DrawingPanePrivate *priv;
+
+	priv = pane->priv;
+	priv->drag_x = x;
+	priv->drag_y = y;
+
+	if (priv->drag_tick == 0) {
+		priv->drag_tick = gtk_widget_add_tick_callback(GTK_WIDGET(priv->drawing_area), apply_drag, pane, NULL);
+	}
+}
+
+static void
+stop_drag(DrawingPane *pane)
+{
+	DrawingPanePrivate *priv;
+
+	priv = pane->priv;
+
+	if (priv->drag_tick != 0) {
+		gtk_widget_remove_tick_callback(GTK_WIDGET(priv->drawing_area), priv->drag_tick);
+		priv->drag_tick = 0;
+	}
+}
+
+// The segment after the point goes, the ones around it are redone
+static void
+delete_b_spline_point(DrawingPane *pane, guint id, Point *point)
+{
+	SceneItem *spline;
+	guint first, last;
+
+	spline = scene_get(pane->priv->scene, id);
+	get_point_segments(spline, g_list_index(spline->points, point), &first, &last);
+
+	unindex_point(pane, point);
+	spline->points = g_list_remove(spline->points, point);
+	g_free(point);
+
+	splice_spline(pane, spline, first, last - first + 1, last - first);
+}
+
+// Appends the points of tail to spline and frees tail. Only the three
+// segments around the joint are new
+static void
+join_b_splines(DrawingPane *pane, guint id, guint tail_id)
+{
+	SceneItem *spline, *tail;
+	GList *list;
+	guint joint;
+
+	spline = scene_get(pane->priv->scene, id);
+	tail = scene_get(pane->priv->scene, tail_id);
+	joint = spline->segments->len - 2;
+
+	for (list = tail->points; list != NULL; list = g_list_next(list)) {
+		g_hash_table_insert(pane->priv->point_splines, list->data, GUINT_TO_POINTER(id));
+	}
+
+	splice_spline(pane, spline, joint, 2, 0);
+	splice_spline(pane, tail, 0, 2, 0);
+
+	g_ptr_array_set_size(spline->segments, joint + tail->segments->len);
+	memcpy(spline->segments->pdata + joint, tail->segments->pdata,
+			tail->segments->len * sizeof(gpointer));
+	g_ptr_array_set_size(tail->segments, 0);
+
+	spline->points = g_list_concat(spline->points, tail->points);
+	tail->points = NULL;
+
+	free_item(pane, tail_id);
+
+	splice_spline(pane, spline, joint, 0, 3);
+}
+
+static guint
+add_figure(DrawingPane *pane, SceneKind kind, const gint *params)
+{
+	SceneItem *item;
+	Figure *figure;
+	guint id;
+
+	id = scene_add_figure(pane->priv->scene, kind, params);
+	item = scene_get(pane->priv->scene, id);
+
+	figure = g_ptr_array_index(item->segments, 0);
+	index_figure(pane, figure);
+
+	commit_figure(pane, figure);
+
+	return id;
+}
+
+// Undoes join_b_splines(): the points of spline id after the first
+// n_points go back to a spline of their own, which gets the id the
+// tail had. Only the segments around the joint are new
+static guint
+split_b_spline(DrawingPane *pane, guint id, guint n_points)
+{
+	SceneItem *spline, *tail;
+	GList *points, *list;
+	guint joint, tail_id;
+
+	spline = scene_get(pane->priv->scene, id);
+	joint = n_points - 1;
+
+	splice_spline(pane, spline, joint, 3, 0);
+
+	points = g_list_nth(spline->points, n_points);
+	points->prev->next = NULL;
+	points->prev = NULL;
+
+	tail_id = scene_add(pane->priv->scene, SCENE_KIND_B_SPLINE, points);
+	spline = scene_get(pane->priv->scene, id);
+	tail = scene_get(pane->priv->scene, tail_id);
+
+	for (list = points; list != NULL; list = g_list_next(list)) {
+		g_hash_table_insert(pane->priv->point_splines, list->data, GUINT_TO_POINTER(tail_id));
+	}
+
+	g_ptr_array_set_size(tail->segments, spline->segments->len - joint);
+	if (tail->segments->len > 0) {
+		memcpy(tail->segments->pdata, spline->segments->pdata + joint,
+				tail->segments->len * sizeof(gpointer));
+	}
+	g_ptr_array_set_size(spline->segments, joint);
+
+	splice_spline(pane, spline, joint, 0, 2);
+	splice_spline(pane, tail, 0, 0, 2);
+
+	invalidate_points(pane, spline->points);
+	invalidate_points(pane, tail->points);
+
+	return tail_id;
+}
+
+// Undoes delete_b_spline_point()
+static void
+insert_b_spline_point(DrawingPane *pane, guint id, guint index, gint x, gint y)
+{
+	SceneItem *spline;
+	Point *point;
+	guint first, last;
+
+	spline = scene_get(pane->priv->scene, id);
+
+	point = g_malloc(sizeof(Point));
+	point->x = x;
+	point->y = y;
+	spline->points = g_list_insert(spline->points, point, index);
+
+	index_point(pane, id, point);
+	invalidate_point(pane, point);
+
+	// The segments delete_b_spline_point() replaced, one more of them
+	first = MAX((gint) index - 1, 0);
+	last = MIN(index + 2, spline->segments->len);
+	splice_spline(pane, spline, first, last - first, last - first + 1);
+}
+
+// Adds a figure or a spline from the parameters or point coordinates
+// kept in the history. Returns its id
+static GList *
+new_points(const gint *values, guint n_values)
+{
+	GList *points;
+	Point *point;
+
+	points = NULL;
+	for (; n_values > 0; n_values -= 2) {
+		point = g_malloc(sizeof(Point));
+		point->x = values[n_values - 2];
+		point->y = values[n_values - 1];
+		points = g_list_prepend(points, point);
+	}
+
+	return points;
+}
+
+static guint
+restore_item(DrawingPane *pane, SceneKind kind, const gint *values, guint n_values)
+{
+	GList *points;
+	guint id;
+
+	if (scene_kinds[kind].get_segment_count == NULL) {
+		return add_figure(pane, kind, values);
+	}
+
+	points = new_points(values, n_values);
+	id = create_spline(pane, points, kind);
+	invalidate_points(pane, points);
+
+	return id;
+}
+
+// Parameters of a figure or point coordinates of a spline
+static void
+append_item_values(GArray *values, SceneItem *item)
+{
+	Figure *figure;
+	GList *list;
+	Point *point;
+
+	if (scene_kinds[item->kind].get_segment_count == NULL) {
+		figure = g_ptr_array_index(item->segments, 0);
+		g_array_append_vals(values, figure->params, scene_kinds[item->kind].n_params);
+		return;
+	}
+
+	for (list = item->points; list != NULL; list = g_list_next(list)) {
+		point = list->data;
+		g_array_append_val(values, point->x);
+		g_array_append_val(values, point->y);
+	}
+}
+
+// Logs the addition or removal of item id, with what restores it
+static void
+record_item(DrawingPane *pane, CommandType type, guint id)
+{
+	SceneItem *item;
+	Command command;
+	GArray *values;
+
+	item = scene_get(pane->priv->scene, id);
+
+	memset(&command, 0, sizeof(command));
+	command.type = type;
+	command.kind = item->kind;
+	command.id = id;
+
+	values = g_array_new(FALSE, FALSE, sizeof(gint));
+	append_item_values(values, item);
+	command_log_push(pane->priv->history, &command, (const gint *) values->data, values->len);
+	g_array_free(values, TRUE);
+}
+
+// Logs the items an import added as one command
+static void
+record_import(DrawingPane *pane, GArray *ids)
+{
+	SceneItem *item;
+	Command command;
+	GArray *values;
+	gint kind, start;
+	guint i;
+
+	memset(&command, 0, sizeof(command));
+	command.type = COMMAND_IMPORT_ITEMS;
+	command.index = ids->len;
+
+	values = g_array_new(FALSE, FALSE, sizeof(gint));
+	g_array_append_vals(values, ids->data, ids->len);
+	for (i = 0; i < ids->len; ++i) {
+		item = scene_get(pane->priv->scene, g_array_index(ids, guint, i));
+
+		kind = item->kind;
+		g_array_append_val(values, kind);
+		start = values->len;
+		g_array_append_val(values, start); // the number of values, set below
+		append_item_values(values, item);
+		g_array_index(values, gint, start) = values->len - start - 1;
+	}
+	command_log_push(pane->priv->history, &command, (const gint *) values->data, values->len);
+	g_array_free(values, TRUE);
+}
+
+// Logs the drag of the point with index from drag_origin to its place
+static void
+record_move(DrawingPane *pane, guint id, Point *point)
+{
+	DrawingPanePrivate *priv;
+	Command command;
+
+	priv = pane->priv;
+
+	if (priv->drag_origin.x == point->x && priv->drag_origin.y == point->y) {
+		return;
+	}
+
+	memset(&command, 0, sizeof(command));
+	command.type = COMMAND_MOVE_POINT;
+	command.id = id;
+	command.index = g_list_index(scene_get(priv->scene, id)->points, point);
+	command.x = priv->drag_origin.x;
+	command.y = priv->drag_origin.y;
+	command.to_x = point->x;
+	command.to_y = point->y;
+	command_log_push(priv->history, &command, NULL, 0);
+}
+
+static void
+record_delete(DrawingPane *pane, guint id, Point *point)
+{
+	Command command;
+
+	memset(&command, 0, sizeof(command));
+	command.type = COMMAND_DELETE_POINT;
+	command.id = id;
+	command.index = g_list_index(scene_get(pane->priv->scene, id)->points, point);
+	command.x = point->x;
+	command.y = point->y;
+	command_log_push(pane->priv->history, &command, NULL, 0);
+}
+
+static void
+record_join(DrawingPane *pane, guint id, guint tail_id, gboolean reverse_head, gboolean reverse_tail)
+{
+	Command command;
+
+	memset(&command, 0, sizeof(command));
+	command.type = COMMAND_JOIN_SPLINES;
+	command.id = id;
+	command.tail_id = tail_id;
+	command.index = g_list_length(scene_get(pane->priv->scene, id)->points);
+	command.reverse_head = reverse_head;
+	command.reverse_tail = reverse_tail;
+	command_log_push(pane->priv->history, &command, NULL, 0);
+}
+
+// Removes the items of an import, the last added first so their ids
+// go back to the scene as the import took them. As for the import,
+// the canvas is redrawn once
+static void
+remove_imported_items(DrawingPane *pane, const Command *command)
+{
+	DrawingPanePrivate *priv;
+	const gint *ids;
+	guint i, id;
+
+	priv = pane->priv;
+	ids = command_log_get_values(priv->history, command);
+
+	for (i = command->index; i-- > 0;) {
+		id = ids[i];
+		unindex_item(id, scene_get(priv->scene, id), pane);
+		scene_remove(priv->scene, id);
+	}
+
+	invalidate_canvas(pane);
+}
+
+static void
+add_imported_items(DrawingPane *pane, const Command *command)
+{
+	DrawingPanePrivate *priv;
+	const gint *ids, *values;
+	SceneKind kind;
+	guint i, id, n;
+
+	priv = pane->priv;
+	ids = command_log_get_values(priv->history, command);
+	values = ids + command->index;
+
+	for (i = 0; i < command->index; ++i) {
+		kind = values[0];
+		n = values[1];
+		if (scene_kinds[kind].get_segment_count == NULL) {
+			id = scene_add_figure(priv->scene, kind, values + 2);
+		} else {
+			id = scene_add_spline(priv->scene, kind, new_points(values + 2, n));
+		}
+		g_warn_if_fail(id == (guint) ids[i]);
+
+		index_item(id, scene_get(priv->scene, id), pane);
+		values += n + 2;
+	}
+
+	invalidate_canvas(pane);
+}
+
+// Commands are replayed on the items they were recorded for, which
+// get back the same ids as long as undo and redo go in order
+static void
+undo_command(DrawingPane *pane, const Command *command)
+{
+	DrawingPanePrivate *priv;
+	SceneItem *spline;
+	guint id;
+
+	priv = pane->priv;
+
+	switch (command->type) {
+	case COMMAND_ADD_ITEM:
+		free_item(pane, command->id);
+		break;
+	case COMMAND_REMOVE_ITEM:
+		id = restore_item(pane, command->kind, command_log_get_values(priv->history, command), command->n_values);
+		g_warn_if_fail(id == command->id);
+		break;
+	case COMMAND_MOVE_POINT:
+		spline = scene_get(priv->scene, command->id);
+		move_point(pane, command->id, g_list_nth_data(spline->points, command->index), command->x, command->y);
+		break;
+	case COMMAND_DELETE_POINT:
+		insert_b_spline_point(pane, command->id, command->index, command->x, command->y);
+		break;
+	case COMMAND_JOIN_SPLINES:
+		id = split_b_spline(pane, command->id, command->index);
+		g_warn_if_fail(id == command->tail_id);
+		if (command->reverse_head) {
+			reverse_spline(scene_get(priv->scene, command->id));
+		}
+		if (command->reverse_tail) {
+			reverse_spline(scene_get(priv->scene, command->tail_id));
+		}
+		break;
+	case COMMAND_IMPORT_ITEMS:
+		remove_imported_items(pane, command);
+		break;
+	}
+}
+
+static void
+redo_command(DrawingPane *pane, const Command *command)
+{
+	DrawingPanePrivate *priv;
+	SceneItem *spline, *tail;
+	Point *point;
+	guint id;
+
+	priv = pane->priv;
+
+	switch (command->type) {
+	case COMMAND_ADD_ITEM:
+		id = restore_item(pane, command->kind, command_log_get_values(priv->history, command), command->n_values);
+		g_warn_if_fail(id == command->id);
+		break;
+	case COMMAND_REMOVE_ITEM:
+		free_item(pane, command->id);
+		break;
+	case COMMAND_MOVE_POINT:
+		spline = scene_get(priv->scene, command->id);
+		move_point(pane, command->id, g_list_nth_data(spline->points, command->index), command->to_x, command->to_y);
+		break;
+	case COMMAND_DELETE_POINT:
+		point = g_list_nth_data(scene_get(priv->scene, command->id)->points, command->index);
+		invalidate_point(pane, point);
+		delete_b_spline_point(pane, command->id, point);
+		break;
+	case COMMAND_JOIN_SPLINES:
+		spline = scene_get(priv->scene, command->id);
+		tail = scene_get(priv->scene, command->tail_id);
+		if (command->reverse_tail) {
+			reverse_spline(tail);
+		}
+		if (command->reverse_head) {
+			reverse_spline(spline);
+		}
+		invalidate_points(pane, spline->points);
+		invalidate_points(pane, tail->points);
+		join_b_splines(pane, command->id, command->tail_id);
+		break;
+	case COMMAND_IMPORT_ITEMS:
+		add_imported_items(pane, command);
+		break;
+	}
+}
+
+static void
+index_item(guint id, SceneItem *item, gpointer user_data)
+{
+	DrawingPane *pane = user_data;
+	GList *list;
+	guint i;
+
+	for (list = item->points; list != NULL; list = g_list_next(list)) {
+		index_point(pane, id, list->data);
+	}
+
+	for (i = 0; i < item->segments->len; ++i) {
+		index_figure(pane, g_ptr_array_index(item->segments, i));
+	}
+}
+
+static void
+unindex_item(guint id, SceneItem *item, gpointer user_data)
+{
+	DrawingPane *pane = user_data;
+	GList *list;
+	guint i;
+
+	for (list = item->points; list != NULL; list = g_list_next(list)) {
+		unindex_point(pane, list->data);
+	}
+
+	for (i = 0; i < item->segments->len; ++i) {
+		unindex_figure(pane, g_ptr_array_index(item->segments, i));
+	}
+}
+
+// Everything is redrawn on the next frame
+static void
+invalidate_canvas(DrawingPane *pane)
+{
+	DrawingPanePrivate *priv;
+	cairo_rectangle_int_t rect;
+
+	priv = pane->priv;
+
+	rect.x = rect.y = 0;
+	rect.width = priv->width;
+	rect.height = priv->height;
+	cairo_region_union_rectangle(priv->figures_damage, &rect);
+	tile_cache_clear(priv->tiles);
+
+	gtk_widget_queue_draw(GTK_WIDGET(priv->drawing_area));
+}
+
+// Replaces the drawing with scene on a width x height canvas. Nothing
+// is rasterized here, figures are drawn as they come into view
+static void
+set_scene(DrawingPane *pane, Scene *scene, gint width, gint height)
+{
+	DrawingPanePrivate *priv;
+
+	priv = pane->priv;
+
+	clear_list(&priv->created_points);
+	stop_drag(pane);
+	priv->move_spline = 0;
+	priv->old_point = NULL;
+
+	scene_free(priv->scene);
+	spatial_grid_free(priv->figure_grid);
+	spatial_grid_free(priv->point_grid);
+	g_hash_table_remove_all(priv->point_splines);
+
+	priv->scene = scene;
+	priv->figure_grid = spatial_grid_new(FIGURE_GRID_CELL_SIZE);
+	priv->point_grid = spatial_grid_new(POINT_GRID_CELL_SIZE);
+	scene_foreach(scene, SCENE_KIND_NONE, index_item, pane);
+	command_log_clear(priv->history);
+
+	if (width != priv->width || height != priv->height) {
+		priv->width = width;
+		priv->height = height;
+		gtk_widget_set_size_request(GTK_WIDGET(priv->drawing_area),
+				width * priv->cell_size, height * priv->cell_size);
+	}
+
+	invalidate_canvas(pane);
+}
+
+
+static void
+clear_created_points(DrawingPane *pane)
+{
+	invalidate_points(pane, pane->priv->created_points);
+	clear_list(&pane->priv->created_points);
+}
+
+typedef struct _RepairData RepairData;
+struct _RepairData {
+	DrawingPane *pane;
+	cairo_rectangle_int_t *rect;
+};
+
+static void
+draw_figure_in_rect(gpointer figure, const Bounds *bounds, gpointer user_data)
+{
+	RepairData *repair_data = user_data;
+
+	draw_figure(figure, repair_data->rect, repair_data->pane);
+}
+
+// Committed figures are rasterized into figures_surface once, after
+// that only damaged cells inside visible_rect are cleared and redrawn
+static void
+repair_figures_surface(DrawingPane *pane, const cairo_rectangle_int_t *visible_rect)
+{
+	DrawingPanePrivate *priv;
+	cairo_rectangle_int_t rect;
+	cairo_region_t *repaired;
+	RepairData repair_data;
+	Bounds bounds;
+	guchar *data;
+	gint stride;
+	gint i, y;
+
+	priv = pane->priv;
+
+	if (priv->figures_surface != NULL &&
+			(cairo_image_surface_get_width(priv->figures_surface) != priv->width ||
+			cairo_image_surface_get_height(priv->figures_surface) != priv->height)) {
+		cairo_surface_destroy(priv->figures_surface);
+		priv->figures_surface = NULL;
+	}
+
+	if (priv->figures_surface == NULL) {
+		priv->figures_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, priv->width, priv->height);
+
+		rect.x = rect.y = 0;
+		rect.width = priv->width;
+		rect.height = priv->height;
+		cairo_region_union_rectangle(priv->figures_damage, &rect);
+	}
+
+	// Figures of a document may reach outside the canvas
+	rect.x = rect.y = 0;
+	rect.width = priv->width;
+	rect.height = priv->height;
+	cairo_region_intersect_rectangle(priv->figures_damage, &rect);
+
+	repaired = cairo_region_copy(priv->figures_damage);
+	cairo_region_intersect_rectangle(repaired, visible_rect);
+
+	if (cairo_region_is_empty(repaired)) {
+		cairo_region_destroy(repaired);
+		return;
+	}
+
+	cairo_surface_flush(priv->figures_surface);
+
+	data = cairo_image_surface_get_data(priv->figures_surface);
+	stride = cairo_image_surface_get_stride(priv->figures_surface);
+
+	repair_data.pane = pane;
+	repair_data.rect = &rect;
+
+	for (i = 0; i < cairo_region_num_rectangles(repaired); ++i) {
+		cairo_region_get_rectangle(repaired, i, &rect);
+
+		for (y = rect.y; y < rect.y + rect.height; ++y) {
+			memset(data + y * stride + rect.x * 4, 0, rect.width * 4);
+		}
+
+		bounds.x1 = rect.x - priv->width / 2;
+		bounds.x2 = bounds.x1 + rect.width - 1;
+		bounds.y2 = priv->height / 2 - rect.y;
+		bounds.y1 = bounds.y2 - rect.height + 1;
+
+		spatial_grid_query(priv->figure_grid, &bounds, draw_figure_in_rect, &repair_data);
+
+		cairo_surface_mark_dirty_rectangle(priv->figures_surface, rect.x, rect.y, rect.width, rect.height);
+	}
+
+	cairo_region_subtract(priv->figures_damage, repaired);
+	cairo_region_destroy(repaired);
+}
+
+static void
+index_figure(DrawingPane *pane, Figure *figure)
+{
+	if (!figure->is_empty) {
+		spatial_grid_insert(pane->priv->figure_grid, figure, &figure->bounds);
+	}
+}
 
-	priv = DRAWING_PANE(data)->priv;
+static void
+unindex_figure(DrawingPane *pane, Figure *figure)
+{
+	if (!figure->is_empty) {
+		spatial_grid_remove(pane->priv->figure_grid, figure, &figure->bounds);
+	}
+}
 
-	clear_list(&priv->created_points);
-	priv->move_spline = NULL;
-	priv->old_point = NULL;
+static gboolean
+is_tile_in_cells(gint zoom, gint tx, gint ty, gpointer tile, gpointer user_data)
+{
+	const cairo_rectangle_int_t *cells = user_data;
 
-	gtk_widget_queue_draw(GTK_WIDGET(priv->drawing_area));
+	return tx * TILE_SIZE < (cells->x + cells->width) * zoom
+			&& (tx + 1) * TILE_SIZE > cells->x * zoom
+			&& ty * TILE_SIZE < (cells->y + cells->height) * zoom
+			&& (ty + 1) * TILE_SIZE > cells->y * zoom;
 }
 
+// Drops the rendered tiles of every zoom level showing cells
 static void
-drawing_pane_finalize(GObject *obj)
+invalidate_tiles(DrawingPane *pane, const cairo_rectangle_int_t *cells)
 {
-	DrawingPanePrivate *priv;
-
-	//TODO
-
-	if (G_OBJECT_CLASS (drawing_pane_parent_class)->finalize != NULL)
-		G_OBJECT_CLASS (drawing_pane_parent_class)->finalize (obj);
+	tile_cache_remove_if(pane->priv->tiles, is_tile_in_cells, (gpointer) cells);
 }
 
-DrawingPane *
-drawing_pane_new (GraphicsEditorWindow *win)
+// Runs in tile_pool: renders the static layers (figures, net and
+// axis) of the widget square at (tx, ty) * TILE_SIZE. Only the
+// snapshot in the batch and the job's own tile are touched here.
+static void
+render_tile(gpointer data, gpointer user_data)
 {
-	return drawing_pane_new_with_size(win, DRAWING_PANE_DEFAULT_WIDTH, DRAWING_PANE_DEFAULT_HEIGHT);
+	TileJob *job = data;
+	TileBatch *batch = job->batch;
+	cairo_t *cr;
+
+	cairo_surface_flush(job->tile);
+	draw_zoomed_buffer(batch->figures, batch->stride, batch->width, batch->height,
+			cairo_image_surface_get_data(job->tile), cairo_image_surface_get_stride(job->tile),
+			job->tx * TILE_SIZE, job->ty * TILE_SIZE, TILE_SIZE, TILE_SIZE,
+			batch->cell_size, batch->cell_size / 7);
+	cairo_surface_mark_dirty(job->tile);
+
+	cr = cairo_create(job->tile);
+	cairo_translate(cr, - job->tx * TILE_SIZE, - job->ty * TILE_SIZE);
+	draw_coordinate_axis(cr, batch->area_width, batch->area_height, batch->cell_size);
+	cairo_destroy(cr);
+
+	g_mutex_lock(&batch->mutex);
+	if (--batch->pending == 0) {
+		g_cond_signal(&batch->done);
+	}
+	g_mutex_unlock(&batch->mutex);
 }
 
-DrawingPane *
-drawing_pane_new_with_size (GraphicsEditorWindow *win, gint width, gint height)
+// Renders the missing tiles in parallel and waits for all of them
+static void
+render_tiles(DrawingPane *pane, GArray *jobs, const cairo_rectangle_int_t *cells)
 {
-	DrawingPane *pane = g_object_new(DRAWING_PANE_TYPE, NULL);
+	DrawingPanePrivate *priv;
+	TileBatch batch;
+	TileJob *job;
+	guint i;
 
-	pane->priv->window = win;
-	pane->priv->width = width;
-	pane->priv->height = height;
+	priv = pane->priv;
 
-	g_signal_connect(pane->priv->window,
-			"notify::drawing-mode",
-			G_CALLBACK(drawing_mode_changed),
-			pane);
+	repair_figures_surface(pane, cells);
+	cairo_surface_flush(priv->figures_surface);
+
+	batch.figures = cairo_image_surface_get_data(priv->figures_surface);
+	batch.stride = cairo_image_surface_get_stride(priv->figures_surface);
+	batch.width = priv->width;
+	batch.height = priv->height;
+	batch.cell_size = priv->cell_size;
+	gtk_widget_get_size_request(GTK_WIDGET(priv->drawing_area), &batch.area_width, &batch.area_height);
+	batch.pending = jobs->len;
+	g_mutex_init(&batch.mutex);
+	g_cond_init(&batch.done);
+
+	for (i = 0; i < jobs->len; ++i) {
+		job = &g_array_index(jobs, TileJob, i);
+		job->batch = &batch;
+		g_thread_pool_push(priv->tile_pool, job, NULL);
+	}
 
-	return pane;
+	g_mutex_lock(&batch.mutex);
+	while (batch.pending > 0) {
+		g_cond_wait(&batch.done, &batch.mutex);
+	}
+	g_mutex_unlock(&batch.mutex);
+
+	g_mutex_clear(&batch.mutex);
+	g_cond_clear(&batch.done);
 }
 
+// Paints the tiles under the clip area, rendering only those that
+// are not cached yet
 static void
-draw_pixel(cairo_t *cr, Pixel *pixel, DrawingPane *pane)
+draw_tiles(cairo_t *cr, DrawingPane *pane)
 {
-	cairo_set_source_rgba(cr, 0, 0, 0, pixel->alpha);
-	cairo_rectangle(cr,
-			pixel->x + pane->priv->width / 2, - pixel->y + pane->priv->height / 2,
-			1, 1);
-	cairo_fill(cr);
-}
+	DrawingPanePrivate *priv;
+	cairo_surface_t *tile;
+	cairo_rectangle_int_t cells;
+	GArray *visible, *missing;
+	TileJob job, *tile_job;
+	gdouble x1, y1, x2, y2;
+	gint tx, ty, tx1, ty1, tx2, ty2;
+	gint cell_size;
+	guint i;
 
-static void
-draw_figure(cairo_t *cr, GList *figure, DrawingPane *pane) {
-	Pixel *pixel;
+	priv = pane->priv;
+	cell_size = priv->cell_size;
+
+	cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+	tx1 = MAX(0, (gint) floor(x1 / TILE_SIZE));
+	ty1 = MAX(0, (gint) floor(y1 / TILE_SIZE));
+	tx2 = (gint) ceil(x2 / TILE_SIZE);
+	ty2 = (gint) ceil(y2 / TILE_SIZE);
+
+	visible = g_array_new(FALSE, FALSE, sizeof(TileJob));
+	missing = g_array_new(FALSE, FALSE, sizeof(TileJob));
+
+	// Cells shown by the missing tiles
+	cells.x = G_MAXINT;
+	cells.y = G_MAXINT;
+	cells.width = G_MININT;
+	cells.height = G_MININT;
+
+	for (ty = ty1; ty < ty2; ++ty) {
+		for (tx = tx1; tx < tx2; ++tx) {
+			job.tx = tx;
+			job.ty = ty;
+			job.batch = NULL;
+
+			tile = tile_cache_lookup(priv->tiles, cell_size, tx, ty);
+
+			if (tile != NULL) {
+				job.tile = cairo_surface_reference(tile);
+			} else {
+				job.tile = cairo_image_surface_create(CAIRO_FORMAT_RGB24, TILE_SIZE, TILE_SIZE);
+				g_array_append_val(missing, job);
+
+				cells.x = MIN(cells.x, tx * TILE_SIZE / cell_size);
+				cells.y = MIN(cells.y, ty * TILE_SIZE / cell_size);
+				cells.width = MAX(cells.width, ((tx + 1) * TILE_SIZE + cell_size - 1) / cell_size);
+				cells.height = MAX(cells.height, ((ty + 1) * TILE_SIZE + cell_size - 1) / cell_size);
+			}
+
+			g_array_append_val(visible, job);
+		}
+	}
+
+	if (missing->len > 0) {
+		cells.width -= cells.x;
+		cells.height -= cells.y;
+		render_tiles(pane, missing, &cells);
 
-	while (figure != NULL) {
-		pixel = figure->data;
-		draw_pixel(cr, pixel, pane);
-		figure = g_list_next(figure);
+		for (i = 0; i < missing->len; ++i) {
+			tile_job = &g_array_index(missing, TileJob, i);
+			tile_cache_insert(priv->tiles, cell_size, tile_job->tx, tile_job->ty,
+					cairo_surface_reference(tile_job->tile),
+					cairo_image_surface_get_stride(tile_job->tile) * TILE_SIZE);
+		}
+	}
+
+	for (i = 0; i < visible->len; ++i) {
+		tile_job = &g_array_index(visible, TileJob, i);
+
+		cairo_set_source_surface(cr, tile_job->tile, tile_job->tx * TILE_SIZE, tile_job->ty * TILE_SIZE);
+		cairo_rectangle(cr, tile_job->tx * TILE_SIZE, tile_job->ty * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+		cairo_fill(cr);
+
+		cairo_surface_destroy(tile_job->tile);
 	}
+
+	g_array_unref(visible);
+	g_array_unref(missing);
 }
 
 static GraphicsEditorDrawingModeType
@@ -380,119 +1562,71 @@ is_line_drawing_mode(GraphicsEditorDrawingModeType mode) {
 			mode == GRAPHICSEDITOR_DRAWING_MODE_WU_LINE);
 }
 
+// Kind of the splines edited in drawing_mode, SCENE_KIND_NONE for
+// the other modes
+static SceneKind
+get_spline_kind(GraphicsEditorDrawingModeType drawing_mode)
+{
+	switch (drawing_mode) {
+	case GRAPHICSEDITOR_DRAWING_MODE_BEZIER:
+		return SCENE_KIND_BEZIER;
+	case GRAPHICSEDITOR_DRAWING_MODE_HERMIT:
+		return SCENE_KIND_HERMITIAN;
+	case GRAPHICSEDITOR_DRAWING_MODE_B_SPLINE:
+		return SCENE_KIND_B_SPLINE;
+	default:
+		return SCENE_KIND_NONE;
+	}
+}
+
+typedef struct _KeyPointsData KeyPointsData;
+struct _KeyPointsData {
+	cairo_t *cr;
+	DrawingPane *pane;
+};
+
+static void
+draw_spline_key_points(guint id, SceneItem *spline, gpointer user_data)
+{
+	KeyPointsData *data = user_data;
+
+	draw_key_points(data->cr, spline->points, blue_color, data->pane);
+}
+
 gboolean
 drawing_area_draw_handler (GtkWidget *widget, cairo_t *cr, gpointer data) {
     DrawingPanePrivate *priv;
     GraphicsEditorDrawingModeType drawing_mode;
-    Spline *spline;
-    GList *list, *figure_list, *figure;
+    KeyPointsData key_points_data;
+    SceneKind kind;
 	DrawingPane *pane;
 
 	pane = DRAWING_PANE(data);
 	priv = pane->priv;
     drawing_mode = get_drawing_mode(pane);
 
-	cairo_save(cr);
-    cairo_scale(cr, priv->cell_size, priv->cell_size);
-
-	cairo_set_source_rgb (cr, 1, 1, 1);
-	cairo_paint (cr);
-
-	// Adding on surface lines(1st and 2nd order)
-
-	figure_list = priv->figure_list;
-	while (figure_list != NULL) {
-		figure = figure_list->data;
-		draw_figure(cr, figure, pane);
-		figure_list = g_list_next(figure_list);
-	}
-
-	// Adding on surface splines
-
-	figure_list = priv->b_spliens;
-	while (figure_list != NULL) {
-		spline = figure_list->data;
-		if (spline->need_refresh_pixels) {
-			spline->pixels = get_b_spline_figure(spline->points, STEP);
-			spline->need_refresh_pixels = FALSE;
-		}
-		draw_figure(cr, spline->pixels, pane);
-		figure_list = g_list_next(figure_list);
-	}
-
-	figure_list = priv->bezier_forms;
-	while (figure_list != NULL) {
-		spline = figure_list->data;
-		if (spline->need_refresh_pixels) {
-			spline->pixels = get_bezier_figure(spline->points, STEP);
-			spline->need_refresh_pixels = FALSE;
-		}
-		draw_figure(cr, spline->pixels, pane);
-		figure_list = g_list_next(figure_list);
-	}
-
-	figure_list = priv->hermitian_forms;
-	while (figure_list != NULL) {
-		spline = figure_list->data;
-		if (spline->need_refresh_pixels) {
-			// TODO
-			spline->pixels = get_hermitian_figure(spline->points, STEP);
-			spline->need_refresh_pixels = FALSE;
-		}
-		draw_figure(cr, spline->pixels, pane);
-		figure_list = g_list_next(figure_list);
-	}
+	//Drawing figures, net and coordinate axis
+	draw_tiles(cr, pane);
 
     //Drawing key points
 
-    //Finish drawing figures
-	cairo_restore(cr);
-
 	if (g_list_length(priv->created_points) == 1) {
 		draw_point(cr, priv->created_points->data, green_color, pane);
 	}
 
-	if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_BEZIER) {
-		draw_key_points(cr, priv->created_points, green_color, pane);
-
-		list = priv->bezier_forms;
-		while (list != NULL) {
-			spline = list->data;
-			draw_key_points(cr, spline->points, blue_color, pane);
-			list = g_list_next(list);
-		}
-
-	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_B_SPLINE) {
-		draw_key_points(cr, priv->created_points, green_color, pane);
-
-		list = priv->b_spliens;
-		while (list != NULL) {
-			spline = list->data;
-			draw_key_points(cr, spline->points, blue_color, pane);
-			list = g_list_next(list);
-		}
-	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_HERMIT) {
+	kind = get_spline_kind(drawing_mode);
+	if (kind != SCENE_KIND_NONE) {
 		draw_key_points(cr, priv->created_points, green_color, pane);
 
-		list = priv->hermitian_forms;
-		while (list != NULL) {
-			spline = list->data;
-			draw_key_points(cr, spline->points, blue_color, pane);
-			list = g_list_next(list);
-		}
+		key_points_data.cr = cr;
+		key_points_data.pane = pane;
+		scene_foreach(priv->scene, kind, draw_spline_key_points, &key_points_data);
 	}
 
 	if (priv->old_point != NULL) {
 		draw_point(cr, priv->old_point, red_color, pane);
 	}
 
-
-	//Drawing net;
-	draw_net(cr, pane);
-
-	//Drawing coordinate axis
-	draw_coordinate_axis(cr, pane);
-
 	return TRUE;
 }
 
@@ -502,9 +1636,14 @@ draw_key_points(cairo_t *cr, GList *list, Color color, DrawingPane *pane)
     gint i, n;
     Point *point;
     Color boundary_color;
+    gdouble clip_x1, clip_y1, clip_x2, clip_y2;
+    gdouble x, y, margin;
 
     i = 0;
 
+    cairo_clip_extents(cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+    margin = MAX(5, pane->priv->cell_size) * 6 / 5 + 1;
+
     boundary_color = color;
     boundary_color.r *= 0.5;
     boundary_color.b *= 0.5;
@@ -515,11 +1654,19 @@ draw_key_points(cairo_t *cr, GList *list, Color color, DrawingPane *pane)
         i++;
 
 		point = list->data;
-        if (i == 1 || i == n) {
-            draw_point(cr, point, boundary_color, pane);
-        } else {
-            draw_point(cr, point, color, pane);
-        }
+
+		x = (point->x + pane->priv->width / 2 + 0.5) * pane->priv->cell_size;
+		y = (- point->y + pane->priv->height / 2 + 0.5) * pane->priv->cell_size;
+
+		// Skipping markers outside of the redrawn area
+		if (x + margin >= clip_x1 && x - margin <= clip_x2 &&
+				y + margin >= clip_y1 && y - margin <= clip_y2) {
+			if (i == 1 || i == n) {
+				draw_point(cr, point, boundary_color, pane);
+			} else {
+				draw_point(cr, point, color, pane);
+			}
+		}
 
         list = g_list_next(list);
 	}
@@ -597,7 +1744,7 @@ drawing_area_configure_event_handler (GtkWidget *widget, GdkEventConfigure *even
 }
 
 static gboolean
-is_point_boundary(Point *point, Spline *spline) {
+is_point_boundary(Point *point, SceneItem *spline) {
     return g_list_first(spline->points)->data == point
             || g_list_last(spline->points)->data == point;
 }
@@ -617,99 +1764,151 @@ drawing_area_button_release_event_handler(GtkWidget *widget, GdkEventButton *eve
 
 	translate(DRAWING_PANE(data), &x, &y);
 
+	stop_drag(DRAWING_PANE(data));
+
 	if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_BEZIER || drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_HERMIT) {
 		if (priv->old_point != NULL) {
-			priv->old_point->x = x;
-			priv->old_point->y = y;
+			move_point(DRAWING_PANE(data), priv->move_spline, priv->old_point, x, y);
+			record_move(DRAWING_PANE(data), priv->move_spline, priv->old_point);
 
-			priv->move_spline->need_refresh_pixels = TRUE;
-
-			priv->move_spline = NULL;
+			priv->move_spline = 0;
 			priv->old_point = NULL;
 		}
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_B_SPLINE) {
-        if (priv->move_spline != NULL) {
+        if (priv->move_spline != 0) {
 
             Point *near_point = NULL;
-            Spline *near_spline = NULL;
+            guint near_spline = 0;
+            SceneItem *move_spline, *spline;
+            gboolean reverse_head, reverse_tail;
 
-            get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), priv->b_spliens, &near_spline, &near_point);
+            // The point to join, if any, lies under the dragged one
+            get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), SCENE_KIND_B_SPLINE, priv->old_point,
+                    &near_spline, &near_point);
 
-            if (near_point != NULL && priv->old_point != near_point && near_spline != priv->move_spline
-                    && is_point_boundary(priv->old_point, priv->move_spline)
-                    && is_point_boundary(near_point, near_spline)) {
-                if (priv->old_point != priv->move_spline->points->data) {
-                    priv->move_spline->points = g_list_reverse(priv->move_spline->points);
-                }
-                if (near_spline->points->data == near_point) {
-                    near_spline->points = g_list_reverse(near_spline->points);
-                }
+            move_spline = scene_get(priv->scene, priv->move_spline);
+
+            if (near_point != NULL && near_spline != priv->move_spline
+                    && is_point_boundary(priv->old_point, move_spline)
+                    && is_point_boundary(near_point, scene_get(priv->scene, near_spline))) {
+                // Joined splines keep the point where the drag started
+                move_point(DRAWING_PANE(data), priv->move_spline, priv->old_point,
+                        priv->drag_origin.x, priv->drag_origin.y);
 
-                GList *list;
-                list = priv->move_spline->points;
+                spline = scene_get(priv->scene, near_spline);
 
-                while (list != NULL) {
-                    near_spline->points = g_list_append(near_spline->points, list->data);
-                    list = g_list_next(list);
+                reverse_tail = priv->old_point != move_spline->points->data;
+                if (reverse_tail) {
+                    reverse_spline(move_spline);
+                }
+                reverse_head = spline->points->data == near_point;
+                if (reverse_head) {
+                    reverse_spline(spline);
                 }
 
-                clear_list(&priv->move_spline->pixels);
-                g_list_free(priv->move_spline->points);
-                priv->b_spliens = g_list_remove(priv->b_spliens, priv->move_spline);
-                g_free(priv->move_spline);
+                invalidate_point(DRAWING_PANE(data), priv->old_point);
+                invalidate_point(DRAWING_PANE(data), near_point);
 
-                near_spline->need_refresh_pixels = TRUE;
+                record_join(DRAWING_PANE(data), near_spline, priv->move_spline, reverse_head, reverse_tail);
+                join_b_splines(DRAWING_PANE(data), near_spline, priv->move_spline);
 
                 priv->old_point = NULL;
-                priv->move_spline = NULL;
+                priv->move_spline = 0;
             } else {
-                priv->old_point->x = x;
-                priv->old_point->y = y;
-
-                priv->move_spline->need_refresh_pixels = TRUE;
+                move_point(DRAWING_PANE(data), priv->move_spline, priv->old_point, x, y);
+                record_move(DRAWING_PANE(data), priv->move_spline, priv->old_point);
 
-                priv->move_spline = NULL;
+                priv->move_spline = 0;
                 priv->old_point = NULL;
             }
         }
-    } else {
-		return FALSE;
-	}
-
-	gtk_widget_queue_draw(GTK_WIDGET(priv->drawing_area));
+    }
 
     return FALSE;
 }
 
 
-// TODO use minimal distance
+typedef struct _PickData PickData;
+struct _PickData {
+	DrawingPane *pane;
+	SceneKind kind;
+	Point *skip;
+	gdouble x, y;
+	gdouble distance; // to the nearest point so far, at first the pick radius
+	guint spline;
+	Point *point;
+};
+
 static void
-get_nearest_point_to(gint x, gint y, DrawingPane *pane, GList *splines, Spline **out_spline, Point **out_point)
+pick_point(gpointer item, const Bounds *bounds, gpointer user_data)
 {
-    GList *spline_list, *point_list;
-    Spline *spline;
-	gdouble px, py;
-    Point *point;
+	PickData *data;
+	DrawingPanePrivate *priv;
+	guint spline;
+	Point *point;
+	gdouble px, py, distance;
 
-    spline_list = splines;
-    while (spline_list != NULL) {
-        spline = spline_list->data;
-        point_list = spline->points;
-        while (point_list != NULL) {
-            point = point_list->data;
+	data = user_data;
+	priv = data->pane->priv;
+	point = item;
 
-			px = (point->x + pane->priv->width / 2 + 0.5) * pane->priv->cell_size;
-			py = (- point->y +  pane->priv->height / 2 + 0.5) * pane->priv->cell_size;
+	if (point == data->skip) {
+		return;
+	}
 
-            if (hypot(px - x, py - y) < MAX(10, pane->priv->cell_size)) {
-                *out_spline = spline;
-                *out_point = point;
-                return;
-            }
-            point_list = g_list_next(point_list);
-        }
-        spline_list = g_list_next(spline_list);
-    }
+	spline = GPOINTER_TO_UINT(g_hash_table_lookup(priv->point_splines, point));
+	if (scene_get(priv->scene, spline)->kind != data->kind) {
+		return;
+	}
+
+	px = (point->x + priv->width / 2 + 0.5) * priv->cell_size;
+	py = (- point->y + priv->height / 2 + 0.5) * priv->cell_size;
+	distance = hypot(px - data->x, py - data->y);
+
+	if (distance < data->distance) {
+		data->distance = distance;
+		data->spline = spline;
+		data->point = point;
+	}
+}
+
+// Nearest control point of the splines of one kind within the pick
+// radius of the widget point (x, y), other than skip; the outputs are
+// left as they are when there is none
+static void
+get_nearest_point_to(gint x, gint y, DrawingPane *pane, SceneKind kind, Point *skip,
+		guint *out_spline, Point **out_point)
+{
+	DrawingPanePrivate *priv;
+	PickData data;
+	Bounds bounds;
+	gint cell_x, cell_y, radius;
+
+	priv = pane->priv;
+
+	data.pane = pane;
+	data.kind = kind;
+	data.skip = skip;
+	data.x = x;
+	data.y = y;
+	data.distance = MAX(10, priv->cell_size);
+	data.point = NULL;
+
+	cell_x = floor((gdouble) x / priv->cell_size);
+	cell_y = floor((gdouble) y / priv->cell_size);
+	translate(pane, &cell_x, &cell_y);
+	radius = ceil(data.distance / priv->cell_size) + 1;
+
+	bounds.x1 = cell_x - radius;
+	bounds.y1 = cell_y - radius;
+	bounds.x2 = cell_x + radius;
+	bounds.y2 = cell_y + radius;
+	spatial_grid_query(priv->point_grid, &bounds, pick_point, &data);
+
+	if (data.point != NULL) {
+		*out_spline = data.spline;
+		*out_point = data.point;
+	}
 }
 
 static gboolean
@@ -717,9 +1916,9 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 {
 	DrawingPanePrivate *priv;
 	Point *point;
-	Spline *spline;
-	GList *spline_list, *point_list;
+	guint spline;
 	gint x, y;
+	gint params[SCENE_MAX_PARAMS];
 	GraphicsEditorDrawingModeType drawing_mode;
 
 	priv = DRAWING_PANE(data)->priv;
@@ -740,39 +1939,41 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 					point->y = y;
 
 					priv->created_points = g_list_append(priv->created_points, point);
+					invalidate_point(DRAWING_PANE(data), point);
 				} else {
-					GList *line_list;
-
 					point = priv->created_points->data;
 
-					line_list = get_line_figure(drawing_mode, point->x, point->y, x, y);
+					params[0] = point->x;
+					params[1] = point->y;
+					params[2] = x;
+					params[3] = y;
+					spline = add_figure(DRAWING_PANE(data), get_line_kind(drawing_mode), params);
+					record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM, spline);
 
-					priv->figure_list = g_list_append(priv->figure_list, line_list);
-
-					clear_list(&priv->created_points);
+					clear_created_points(DRAWING_PANE(data));
 				}
 				break;
 			case 3:
-				clear_list(&priv->created_points);
+				clear_created_points(DRAWING_PANE(data));
 				break;
 		}
 
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_HYPERBOLE) {
-		GList *hyperbole = get_hyperbole(DRAWING_PANE(data));
-		if (hyperbole) {
-			priv->figure_list = g_list_append(priv->figure_list, hyperbole);
+		if (get_hyperbole(DRAWING_PANE(data), params)) {
+			record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM,
+					add_figure(DRAWING_PANE(data), SCENE_KIND_HYPERBOLE, params));
 		}
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_ELLIPSE) {
-		GList *ellipse = get_ellipse(DRAWING_PANE(data));
-		if (ellipse) {
-			priv->figure_list = g_list_append(priv->figure_list, ellipse);
+		if (get_ellipse(DRAWING_PANE(data), params)) {
+			record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM,
+					add_figure(DRAWING_PANE(data), SCENE_KIND_ELLIPSE, params));
 		}
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_BEZIER) {
 		switch (event->button) {
 			case 1:
 
 				if (priv->created_points == NULL) {
-					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), priv->bezier_forms, &priv->move_spline, &priv->old_point);
+					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), SCENE_KIND_BEZIER, NULL, &priv->move_spline, &priv->old_point);
 				}
 
 				if (priv->old_point == NULL) {
@@ -781,24 +1982,21 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 					point->y = y;
 
 					priv->created_points = g_list_append(priv->created_points, point);
+					invalidate_point(DRAWING_PANE(data), point);
 
 					if (g_list_length(priv->created_points) == 4) {
-						Spline *spline;
-
-						spline = g_malloc(sizeof(Spline));
-
-						spline->points = priv->created_points;
-						spline->need_refresh_pixels = TRUE;
-
-						priv->bezier_forms = g_list_append(priv->bezier_forms, spline);
-
+						spline = create_spline(DRAWING_PANE(data), priv->created_points, SCENE_KIND_BEZIER);
+						record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM, spline);
 						priv->created_points = NULL;
 					}
+				} else {
+					invalidate_point(DRAWING_PANE(data), priv->old_point);
+					begin_drag(DRAWING_PANE(data));
 				}
 
 				break;
 			case 3:
-				clear_list(&priv->created_points);
+				clear_created_points(DRAWING_PANE(data));
 				break;
 		}
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_HERMIT) {
@@ -806,7 +2004,7 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 			case 1:
 
 				if (priv->created_points == NULL) {
-					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), priv->hermitian_forms, &priv->move_spline, &priv->old_point);
+					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), SCENE_KIND_HERMITIAN, NULL, &priv->move_spline, &priv->old_point);
 				}
 
 				if (priv->old_point == NULL) {
@@ -815,67 +2013,66 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 					point->y = y;
 
 					priv->created_points = g_list_append(priv->created_points, point);
+					invalidate_point(DRAWING_PANE(data), point);
 
 					if (g_list_length(priv->created_points) == 4) {
-						Spline *spline;
-
-						spline = g_malloc(sizeof(Spline));
-
-						spline->points = priv->created_points;
-						spline->need_refresh_pixels = TRUE;
-
-						priv->hermitian_forms = g_list_append(priv->hermitian_forms, spline);
-
+						spline = create_spline(DRAWING_PANE(data), priv->created_points, SCENE_KIND_HERMITIAN);
+						record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM, spline);
 						priv->created_points = NULL;
 					}
+				} else {
+					invalidate_point(DRAWING_PANE(data), priv->old_point);
+					begin_drag(DRAWING_PANE(data));
 				}
 
 				break;
 			case 3:
-				clear_list(&priv->created_points);
+				clear_created_points(DRAWING_PANE(data));
 				break;
 		}
 	} else if (drawing_mode == GRAPHICSEDITOR_DRAWING_MODE_B_SPLINE) {
 		switch (event->button) {
 			case 1:
 				if (event->state & GDK_SHIFT_MASK == GDK_SHIFT_MASK) {
-					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), priv->b_spliens, &spline, &point);
+					spline = 0;
+					point = NULL;
+
+					get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), SCENE_KIND_B_SPLINE, NULL, &spline, &point);
 					if (point != NULL) {
-						if (g_list_length(spline->points) > 1) {
-							spline->points = g_list_remove(spline->points, point);
-							spline->need_refresh_pixels = TRUE;
-							g_free(point);
+						if (g_list_length(scene_get(priv->scene, spline)->points) > 1) {
+							invalidate_point(DRAWING_PANE(data), point);
+							record_delete(DRAWING_PANE(data), spline, point);
+							delete_b_spline_point(DRAWING_PANE(data), spline, point);
 						} else {
-							clear_list(&spline->points);
-							clear_list(&spline->pixels);
-							priv->b_spliens = g_list_remove(priv->b_spliens, spline);
-							g_free(spline);
+							record_item(DRAWING_PANE(data), COMMAND_REMOVE_ITEM, spline);
+							free_item(DRAWING_PANE(data), spline);
 						}
 					}
 				} else {
 
 					if (priv->created_points == NULL) {
-						get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), priv->b_spliens, &priv->move_spline, &priv->old_point);
+						get_nearest_point_to(event->x, event->y, DRAWING_PANE(data), SCENE_KIND_B_SPLINE, NULL, &priv->move_spline, &priv->old_point);
 					}
 
-					if (priv->move_spline == NULL) {
+					if (priv->move_spline == 0) {
 						point = g_malloc(sizeof(Point));
 						point->x = x;
 						point->y = y;
 
 						priv->created_points = g_list_append(priv->created_points, point);
+						invalidate_point(DRAWING_PANE(data), point);
+					} else {
+						invalidate_point(DRAWING_PANE(data), priv->old_point);
+						begin_drag(DRAWING_PANE(data));
 					}
 				}
 
 				break;
 			case 3:
 				if (priv->created_points != NULL) {
-					spline = g_malloc(sizeof(Spline));
-
-					spline->need_refresh_pixels = TRUE;
-					spline->points = priv->created_points;
-
-					priv->b_spliens = g_list_append(priv->b_spliens, spline);
+					spline = create_spline(DRAWING_PANE(data), priv->created_points, SCENE_KIND_B_SPLINE);
+					record_item(DRAWING_PANE(data), COMMAND_ADD_ITEM, spline);
+					invalidate_points(DRAWING_PANE(data), priv->created_points);
 					priv->created_points = NULL;
 				}
 				break;
@@ -883,8 +2080,6 @@ drawing_area_button_press_event_handler (GtkWidget *widget, GdkEventButton  *eve
 
 	}
 
-	gtk_widget_queue_draw(widget);
-
 	return FALSE;
 }
 
@@ -897,77 +2092,53 @@ static void clear_list(GList **figure) {
 	}
 }
 
-static GList *
-get_line_figure(GraphicsEditorDrawingModeType drawing_mode, gint x1, gint y1, gint x2, gint y2) {
-	GList *figure;
-
-	figure = NULL;
+static SceneKind
+get_line_kind(GraphicsEditorDrawingModeType drawing_mode) {
 	switch (drawing_mode) {
 	case GRAPHICSEDITOR_DRAWING_MODE_DDA_LINE:
-		figure = get_dda_line_figure(
-				x1, y1,
-				x2, y2);
-		break;
+		return SCENE_KIND_DDA_LINE;
 	case GRAPHICSEDITOR_DRAWING_MODE_BRESENHAM_LINE:
-		figure = get_bresenham_line_figure(
-				x1, y1,
-				x2, y2);
-		break;
+		return SCENE_KIND_BRESENHAM_LINE;
 	case GRAPHICSEDITOR_DRAWING_MODE_WU_LINE:
-		figure = get_wu_line_figure(
-				x1, y1,
-				x2, y2);
-		break;
+		return SCENE_KIND_WU_LINE;
+	default:
+		return SCENE_KIND_NONE;
 	}
-
-	return figure;
 }
 
+// width and height are the size of the drawing area
 static void
-draw_coordinate_axis(cairo_t *cr, DrawingPane *pane) {
-	cairo_set_source_rgb(cr, 0.75, 0.75, 0.25);
-
-	gint width, height, cell_size, line_width;
+draw_coordinate_axis(cairo_t *cr, gint width, gint height, gint cell_size) {
+	gint line_width;
+	gdouble x1, y1, x2, y2;
+	gdouble axis_x, axis_y;
 
-	gtk_widget_get_size_request(GTK_WIDGET(pane->priv->drawing_area), &width, &height);
-	cell_size = pane->priv->cell_size;
 	line_width = cell_size / 3 + 1;
 
-	cairo_set_line_width(cr, line_width);
-
-	cairo_move_to(cr, 0, height / 2 + cell_size / 2);
-	cairo_line_to(cr, width, height / 2 + cell_size / 2);
-
-	cairo_move_to(cr, width / 2 + cell_size / 2, 0);
-	cairo_line_to(cr, width / 2 + cell_size / 2, height);
-
-	cairo_stroke(cr);
-}
-
+	axis_x = width / 2 + cell_size / 2;
+	axis_y = height / 2 + cell_size / 2;
 
-//TODO Drawing net optimization
-static void draw_net(cairo_t* cr, DrawingPane *pane) {
-	gint cell_size = pane->priv->cell_size;
-	gint height = pane->priv->height;
-	gint width = pane->priv->width;
-	gint net_size = cell_size / 7;
-	if (net_size == 0) return;
+	// Only the visible parts of the axis are stroked
+	cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+	x1 = MAX(x1, 0);
+	y1 = MAX(y1, 0);
+	x2 = MIN(x2, width);
+	y2 = MIN(y2, height);
 
-	cairo_set_source_rgb(cr, 0.75, 0.75, 0.75);
-
-	gdouble i;
-	gdouble real_height = height * cell_size;
-	gdouble real_width = width * cell_size;
+	cairo_set_source_rgb(cr, 0.75, 0.75, 0.25);
+	cairo_set_line_width(cr, line_width);
 
-	for (i = 0; i <= width; ++i) {
-		cairo_rectangle(cr, i * cell_size - net_size / 2, 0, net_size, real_height);
+	if (axis_y + line_width / 2.0 >= y1 && axis_y - line_width / 2.0 <= y2) {
+		cairo_move_to(cr, x1, axis_y);
+		cairo_line_to(cr, x2, axis_y);
 	}
 
-	for (i = 0; i <= height; ++i) {
-		cairo_rectangle(cr, 0, i * cell_size - net_size / 2, real_width, net_size);
+	if (axis_x + line_width / 2.0 >= x1 && axis_x - line_width / 2.0 <= x2) {
+		cairo_move_to(cr, axis_x, y1);
+		cairo_line_to(cr, axis_x, y2);
 	}
 
-	cairo_fill(cr);
+	cairo_stroke(cr);
 }
 
 gboolean
@@ -982,19 +2153,23 @@ drawing_area_motion_notify_event_handler (GtkWidget *widget, GdkEventMotion  *ev
 	y = floor(event->y / priv->cell_size);
 	translate(DRAWING_PANE(data), &x, &y);
 
-	g_object_set(data,
-			"cursor-x", x,
-			"cursor-y", y,
-			NULL
-	);
+	if (x != priv->cur_x || y != priv->cur_y) {
+		priv->cur_x = x;
+		priv->cur_y = y;
+		g_signal_emit(data, signals[CURSOR_CHANGED], 0, x, y);
+	}
+
+	if (priv->old_point != NULL && priv->move_spline != 0) {
+		queue_drag(DRAWING_PANE(data), x, y);
+	}
 
 	return FALSE;
 }
 
-static GList *
-get_hyperbole(DrawingPane *pane)
+// Fills the parameters of a conic over the whole canvas
+static gboolean
+get_hyperbole(DrawingPane *pane, gint *params)
 {
-	GList *figure;
 	GtkWidget *dialog;
 	GtkWidget *grid;
 	GtkWidget *content_area;
@@ -1005,8 +2180,6 @@ get_hyperbole(DrawingPane *pane)
 	gint a;
 	gint b;
 
-	figure = NULL;
-
 	dialog = gtk_dialog_new_with_buttons("Add hyperbole",
 			GTK_WINDOW(pane->priv->window),
 			GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -1038,21 +2211,26 @@ get_hyperbole(DrawingPane *pane)
 	b = round(gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_button_b)));
 	gtk_widget_destroy(dialog);
 
-	if (result == GTK_RESPONSE_OK) {
-		figure = get_hyperbole_figure(a, b,
-				- pane->priv->width / 2, - pane->priv->height / 2,
-				pane->priv->width, pane->priv->height);
+	if (result != GTK_RESPONSE_OK) {
+		return FALSE;
 	}
 
-	return figure;
+	params[0] = a;
+	params[1] = b;
+	params[2] = - pane->priv->width / 2;
+	params[3] = - pane->priv->height / 2;
+	params[4] = pane->priv->width;
+	params[5] = pane->priv->height;
+
+	return TRUE;
 }
 
 
 //TODO Lines 2nd order dialog
-static GList *
-get_ellipse(DrawingPane *pane)
+// Fills the parameters of a conic over the whole canvas
+static gboolean
+get_ellipse(DrawingPane *pane, gint *params)
 {
-	GList *figure;
 	GtkWidget *dialog;
 	GtkWidget *grid;
 	GtkWidget *content_area;
@@ -1063,8 +2241,6 @@ get_ellipse(DrawingPane *pane)
 	gint a;
 	gint b;
 
-	figure = NULL;
-
 	dialog = gtk_dialog_new_with_buttons("Add ellipse",
 			GTK_WINDOW(pane->priv->window),
 			GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -1096,13 +2272,18 @@ get_ellipse(DrawingPane *pane)
 	b = round(gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_button_b)));
 	gtk_widget_destroy(dialog);
 
-	if (result == GTK_RESPONSE_OK) {
-		figure = get_ellipse_figure(a, b,
-				- pane->priv->width / 2, - pane->priv->height / 2,
-				pane->priv->width, pane->priv->height);
+	if (result != GTK_RESPONSE_OK) {
+		return FALSE;
 	}
 
-	return figure;
+	params[0] = a;
+	params[1] = b;
+	params[2] = - pane->priv->width / 2;
+	params[3] = - pane->priv->height / 2;
+	params[4] = pane->priv->width;
+	params[5] = pane->priv->height;
+
+	return TRUE;
 }
 
 static void
@@ -1111,3 +2292,109 @@ translate(DrawingPane *pane, gint *x, gint *y) {
 	*y -= pane->priv->height / 2;
 	*y = -1 * *y;
 }
+
+void
+drawing_pane_new_document(DrawingPane *pane)
+{
+	set_scene(pane, scene_new(), pane->priv->width, pane->priv->height);
+}
+
+gboolean
+drawing_pane_load(DrawingPane *pane, const gchar *filename, GError **error)
+{
+	Scene *scene;
+	gint width, height;
+
+	scene = document_load(filename, &width, &height, error);
+	if (scene == NULL) {
+		return FALSE;
+	}
+
+	set_scene(pane, scene, width, height);
+
+	return TRUE;
+}
+
+gboolean
+drawing_pane_save(DrawingPane *pane, const gchar *filename, GError **error)
+{
+	return document_save(pane->priv->scene, pane->priv->width, pane->priv->height, filename, error);
+}
+
+gboolean
+drawing_pane_import(DrawingPane *pane, const gchar *filename, GError **error)
+{
+	DrawingPanePrivate *priv;
+	GraphicsEditorDrawingModeType drawing_mode;
+	SceneKind kind;
+	GArray *ids;
+	guint id, i;
+
+	priv = pane->priv;
+
+	// Records without a kind name are lines unless splines are drawn
+	drawing_mode = get_drawing_mode(pane);
+	kind = is_line_drawing_mode(drawing_mode) ? get_line_kind(drawing_mode) : get_spline_kind(drawing_mode);
+	if (kind == SCENE_KIND_NONE) {
+		kind = SCENE_KIND_BRESENHAM_LINE;
+	}
+
+	ids = g_array_new(FALSE, FALSE, sizeof(guint));
+	if (!import_file(priv->scene, filename, kind, ids, error)) {
+		g_array_free(ids, TRUE);
+		return FALSE;
+	}
+
+	for (i = 0; i < ids->len; ++i) {
+		id = g_array_index(ids, guint, i);
+		index_item(id, scene_get(priv->scene, id), pane);
+	}
+
+	if (ids->len > 0) {
+		record_import(pane, ids);
+	}
+	g_array_free(ids, TRUE);
+
+	invalidate_canvas(pane);
+
+	return TRUE;
+}
+
+gboolean
+drawing_pane_export(DrawingPane *pane, const gchar *filename, GError **error)
+{
+	DrawingPanePrivate *priv = pane->priv;
+
+	return png_export(priv->scene, priv->width, priv->height, priv->cell_size, filename, error);
+}
+
+void
+drawing_pane_undo(DrawingPane *pane)
+{
+	const Command *command;
+
+	// Not while a point is dragged
+	if (pane->priv->old_point != NULL) {
+		return;
+	}
+
+	command = command_log_undo(pane->priv->history);
+	if (command != NULL) {
+		undo_command(pane, command);
+	}
+}
+
+void
+drawing_pane_redo(DrawingPane *pane)
+{
+	const Command *command;
+
+	if (pane->priv->old_point != NULL) {
+		return;
+	}
+
+	command = command_log_redo(pane->priv->history);
+	if (command != NULL) {
+		redo_command(pane, command);
+	}
+}
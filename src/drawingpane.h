@@ -29,6 +29,21 @@ GType drawing_pane_get_type (void);
 DrawingPane *drawing_pane_new (GraphicsEditorWindow *win);
 DrawingPane *drawing_pane_new_with_size (GraphicsEditorWindow *win, gint width, gint height);
 
+/* Start an empty drawing, or replace the drawing with a document */
+void drawing_pane_new_document(DrawingPane *pane);
+gboolean drawing_pane_load(DrawingPane *pane, const gchar *filename, GError **error);
+gboolean drawing_pane_save(DrawingPane *pane, const gchar *filename, GError **error);
+
+/* Undo or redo the last edit; an import is one edit. Opening or starting a drawing forgets the edits */
+void drawing_pane_undo(DrawingPane *pane);
+void drawing_pane_redo(DrawingPane *pane);
+
+/* Add the figures of a survey data file, of the kind being drawn */
+gboolean drawing_pane_import(DrawingPane *pane, const gchar *filename, GError **error);
+
+/* Write the drawing as a PNG image at the current zoom */
+gboolean drawing_pane_export(DrawingPane *pane, const gchar *filename, GError **error);
+
 G_END_DECLS
 
 #endif /* __DRAWINGPANE_H */
@@ -4,11 +4,17 @@
 
 #define SQR(A) (A) * (A)
 
+// Curve segments are split at most CURVE_MAX_DEPTH times, and only
+// while they take more than CURVE_SPLIT_STEPS steps
+#define CURVE_MAX_DEPTH 4
+#define CURVE_SPLIT_STEPS 16
+#define CURVE_MAX_STEPS (1 << 20)
+
 static gint sign(gdouble x);
 static void swap(gint *a, gint *b);
-static void add_pixel(GList **figure, gint x, gint y);
-static void add_pixel_with_alpha(GList **figure, gint x, gint y, gdouble alpha);
-static gboolean add_pixel_in_zone(GList **figure, gint x, gint y, gint x0, gint y0, gint width, gint height);
+static void reverse_figure(GArray *figure);
+static void add_pixel(GArray *figure, gint x, gint y);
+static void add_pixel_with_alpha(GArray *figure, gint x, gint y, gdouble alpha);
 
 static
 gint sign(gdouble x) {
@@ -21,33 +27,189 @@ gint sign(gdouble x) {
 	}
 }
 
-static void
-add_pixel_with_alpha(GList **figure, gint x, gint y, gdouble alpha) {
-	Pixel *pixel;
+GArray *
+figure_new(guint reserved_size) {
+	return g_array_sized_new(FALSE, FALSE, sizeof(Pixel), reserved_size);
+}
+
+void
+figure_free(GArray *figure) {
+	if (figure != NULL) {
+		g_array_unref(figure);
+	}
+}
 
-	pixel = g_malloc(sizeof(Pixel));
+static void
+add_pixel_with_alpha(GArray *figure, gint x, gint y, gdouble alpha) {
+	Pixel pixel;
 
-	pixel->x = x;
-	pixel->y = y;
-	pixel->alpha = alpha;
+	pixel.x = x;
+	pixel.y = y;
+	pixel.alpha = alpha;
 
-	*figure = g_list_append(*figure, pixel);
+	g_array_append_val(figure, pixel);
 }
 
 static void
-add_pixel(GList **figure, gint x, gint y) {
+add_pixel(GArray *figure, gint x, gint y) {
 	add_pixel_with_alpha(figure, x, y, 1);
 }
 
-GList *
+gboolean
+bounds_intersect(const Bounds *a, const Bounds *b)
+{
+	return a->x1 <= b->x2 && b->x1 <= a->x2 &&
+			a->y1 <= b->y2 && b->y1 <= a->y2;
+}
+
+void
+draw_figure_on_buffer(GArray *figure, guchar *data, gint stride,
+		gint origin_x, gint origin_y,
+		gint clip_x, gint clip_y, gint clip_width, gint clip_height)
+{
+	draw_pixels_on_buffer((const Pixel *) figure->data, figure->len, data, stride,
+			origin_x, origin_y, clip_x, clip_y, clip_width, clip_height);
+}
+
+void
+draw_pixels_on_buffer(const Pixel *pixels, guint n, guchar *data, gint stride,
+		gint origin_x, gint origin_y,
+		gint clip_x, gint clip_y, gint clip_width, gint clip_height)
+{
+	const Pixel *pixel;
+	guint32 *cell;
+	guint32 color, inv;
+	gint x, y;
+	guint i;
+
+	for (i = 0; i < n; ++i) {
+		pixel = &pixels[i];
+
+		x = origin_x + pixel->x;
+		y = origin_y - pixel->y;
+
+		if (x < clip_x || x >= clip_x + clip_width ||
+				y < clip_y || y >= clip_y + clip_height) {
+			continue;
+		}
+
+		cell = (guint32 *) (data + y * stride) + x;
+
+		if (pixel->alpha >= 1) {
+			*cell = 0xff000000;
+			continue;
+		}
+
+		// OVER operator for black with premultiplied alpha
+		inv = 255 - (guint32) round(CLAMP(pixel->alpha, 0, 1) * 255);
+		color = *cell;
+
+		*cell = ((255 - inv + ((color >> 24) * inv + 127) / 255) << 24)
+				| (((color >> 16 & 0xff) * inv + 127) / 255) << 16
+				| (((color >> 8 & 0xff) * inv + 127) / 255) << 8
+				| ((color & 0xff) * inv + 127) / 255;
+	}
+}
+
+// Source cell of every magnified column (-1 outside of the canvas),
+// whether the column is covered by the net at all and whether it lies
+// on a net line
+static void
+get_zoomed_columns(gint x, gint width, gint src_width, gint cell_size, gint net_size,
+		gint *cells, gboolean *in_net, gboolean *on_net_line)
+{
+	gint i, px, offset;
+
+	for (i = 0; i < width; ++i) {
+		px = x + i;
+		offset = px + net_size / 2;
+
+		cells[i] = px >= 0 && px < src_width * cell_size ? px / cell_size : -1;
+		in_net[i] = net_size > 0 && offset >= 0 && px < src_width * cell_size + net_size - net_size / 2;
+		on_net_line[i] = in_net[i] && offset % cell_size < net_size;
+	}
+}
+
+void
+draw_zoomed_buffer(const guchar *src, gint src_stride, gint src_width, gint src_height,
+		guchar *dest, gint dest_stride, gint x, gint y, gint width, gint height,
+		gint cell_size, gint net_size)
+{
+	const guint32 white = 0xffffffff, grey = 0xffbfbfbf;
+	const guint32 *src_row;
+	guint32 *dest_row;
+	guint32 color, inv;
+	gint *column_cells, *row_cells;
+	gboolean *column_in_net, *row_in_net;
+	gboolean *column_on_line, *row_on_line;
+	gint i, j;
+
+	column_cells = g_new(gint, width);
+	column_in_net = g_new(gboolean, width);
+	column_on_line = g_new(gboolean, width);
+	row_cells = g_new(gint, height);
+	row_in_net = g_new(gboolean, height);
+	row_on_line = g_new(gboolean, height);
+
+	get_zoomed_columns(x, width, src_width, cell_size, net_size,
+			column_cells, column_in_net, column_on_line);
+	get_zoomed_columns(y, height, src_height, cell_size, net_size,
+			row_cells, row_in_net, row_on_line);
+
+	for (j = 0; j < height; ++j) {
+		dest_row = (guint32 *) (dest + j * dest_stride);
+		src_row = row_cells[j] >= 0 ? (const guint32 *) (src + row_cells[j] * src_stride) : NULL;
+
+		for (i = 0; i < width; ++i) {
+			if (row_in_net[j] && column_in_net[i] && (row_on_line[j] || column_on_line[i])) {
+				dest_row[i] = grey;
+			} else if (src_row == NULL || column_cells[i] < 0) {
+				dest_row[i] = white;
+			} else {
+				// OVER a white background
+				color = src_row[column_cells[i]];
+				inv = 255 - (color >> 24);
+				dest_row[i] = 0xff000000 | (color + (inv << 16 | inv << 8 | inv));
+			}
+		}
+	}
+
+	g_free(column_cells);
+	g_free(column_in_net);
+	g_free(column_on_line);
+	g_free(row_cells);
+	g_free(row_in_net);
+	g_free(row_on_line);
+}
+
+static void
+reverse_figure(GArray *figure) {
+	Pixel *pixels;
+	Pixel o;
+	guint i, j;
+
+	if (figure->len == 0) {
+		return;
+	}
+
+	pixels = (Pixel *) figure->data;
+
+	for (i = 0, j = figure->len - 1; i < j; ++i, --j) {
+		o = pixels[i];
+		pixels[i] = pixels[j];
+		pixels[j] = o;
+	}
+}
+
+GArray *
 get_dda_line_figure(gint x1, gint y1, gint x2, gint y2) {
-	GList *figure;
+	GArray *figure;
 	gint length;
 	gdouble dx, dy;
 	gdouble x, y;
 
-	figure = NULL;
 	length = MAX(abs(x2 - x1), abs(y2 - y1));
+	figure = figure_new(length + 1);
 
 	dx = (x2 - x1) / (gfloat)length;
 	dy = (y2 - y1) / (gfloat)length;
@@ -57,7 +219,7 @@ get_dda_line_figure(gint x1, gint y1, gint x2, gint y2) {
 
 	gint i;
 	for (i = 0; i <= length; ++i) {
-		add_pixel(&figure, round(x), round(y));
+		add_pixel(figure, round(x), round(y));
 		x += dx;
 		y += dy;
 	}
@@ -72,16 +234,16 @@ swap(gint *a, gint *b) {
 	*b = o;
 }
 
-GList *
+GArray *
 get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2) {
-	GList *figure;
+	GArray *figure;
 	gint dx, dy;
 	gint e, x, y;
 	gboolean is_swaped = FALSE;
 
-	figure = NULL;
 	dx = abs(x2 - x1);
 	dy = abs(y2 - y1);
+	figure = figure_new(MAX(dx, dy) + 1);
 
 	if (dx > dy) {
 		if (x1 > x2) {
@@ -94,7 +256,7 @@ get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2) {
 		e = dy;
 
 		for (x = x1, y = y1; x <= x2; ++x) {
-			add_pixel(&figure, x, y);
+			add_pixel(figure, x, y);
 
 			if (2 * e >= dx) {
 				y += inc_y;
@@ -114,7 +276,7 @@ get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2) {
 		e = dx;
 
 		for (x = x1, y = y1; y <= y2 + 0.5; ++y) {
-			add_pixel(&figure, x, y);
+			add_pixel(figure, x, y);
 
 			if (2 * e >= dy) {
 				x += inc_x;
@@ -126,15 +288,15 @@ get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2) {
 	}
 
 	if (is_swaped == TRUE) {
-		figure = g_list_reverse(figure);
+		reverse_figure(figure);
 	}
 
 	return figure;
 }
 
-GList *
+GArray *
 get_wu_line_figure(gint x1, gint y1, gint x2, gint y2) {
-	GList *figure;
+	GArray *figure;
 	gint dx, dy, steps;
 	gdouble e, de;
 	gint x, y;
@@ -146,7 +308,6 @@ get_wu_line_figure(gint x1, gint y1, gint x2, gint y2) {
 	gint step_inc_x;
 	gint step_inc_y;
 
-	figure = NULL;
 	dx = abs(x2 - x1);
 	dy = abs(y2 - y1);
 
@@ -154,6 +315,8 @@ get_wu_line_figure(gint x1, gint y1, gint x2, gint y2) {
 		return get_bresenham_line_figure(x1, y1, x2, y2);
 	}
 
+	figure = figure_new(2 * (MAX(dx, dy) + 1));
+
 	if (dx > dy) {
 		step_inc_x = x1 > x2 ? -1 : 1;
 		step_inc_y = 0;
@@ -175,8 +338,8 @@ get_wu_line_figure(gint x1, gint y1, gint x2, gint y2) {
 	x = x1; y = y1;
 
 	for (i = 0; i <= steps; ++i) {
-		add_pixel_with_alpha(&figure, x, y, 1 - e);
-		add_pixel_with_alpha(&figure, x + d_second_x, y + d_second_y, e);
+		add_pixel_with_alpha(figure, x, y, 1 - e);
+		add_pixel_with_alpha(figure, x + d_second_x, y + d_second_y, e);
 
 		e += de;
 
@@ -193,111 +356,505 @@ get_wu_line_figure(gint x1, gint y1, gint x2, gint y2) {
 	return figure;
 }
 
-static gboolean
-add_pixel_in_zone(GList **figure, gint x, gint y, gint x0, gint y0, gint width, gint height) {
-	if (x >= x0 && x <= x0 + width &&
-			y >= y0 && y <= y0 + height) {
-		add_pixel(figure, x, y);
-		return TRUE;
-	} else {
-		return FALSE;
+// Conic with semi-axes a and b, split into a region with one pixel
+// per column and a region with one pixel per row
+typedef struct _Conic Conic;
+struct _Conic {
+	gint64 a2, b2;
+	gint64 k; // 4 a^2 b^2
+	gint a, b;
+	gint xe, ye; // last pixel of region 1
+	gint xj, yj; // last pixel where region 2 joins region 1
+};
+
+typedef gint (*ArcFunc)(const Conic *conic, gint v);
+
+// Largest v >= 0 with c (2v - 1)^2 <= r, 0 if there is none
+static gint
+midpoint_root(gint64 c, gint64 r)
+{
+	gint v;
+
+	if (r < c) {
+		return 0;
+	}
+
+	v = (gint) ((sqrt((gdouble) r / c) + 1) / 2);
+	while (c * SQR((gint64) 2 * v + 1) <= r) {
+		++v;
+	}
+	while (v > 1 && c * SQR((gint64) 2 * v - 1) > r) {
+		--v;
+	}
+
+	return v;
+}
+
+// Smallest v in [lo, hi] with f(v) < limit for a nonincreasing f,
+// hi + 1 if there is none
+static gint
+search_below(const Conic *conic, ArcFunc f, gint lo, gint hi, gint limit)
+{
+	gint middle;
+
+	++hi;
+	while (lo < hi) {
+		middle = lo + (hi - lo) / 2;
+		if (f(conic, middle) < limit) {
+			hi = middle;
+		} else {
+			lo = middle + 1;
+		}
 	}
+
+	return lo;
+}
+
+// Smallest v in [lo, hi] with f(v) > limit for a nondecreasing f,
+// hi + 1 if there is none
+static gint
+search_above(const Conic *conic, ArcFunc f, gint lo, gint hi, gint limit)
+{
+	gint middle;
+
+	++hi;
+	while (lo < hi) {
+		middle = lo + (hi - lo) / 2;
+		if (f(conic, middle) > limit) {
+			hi = middle;
+		} else {
+			lo = middle + 1;
+		}
+	}
+
+	return lo;
 }
 
-GList *get_hyperbole_figure(gint a, gint b, gint x0, gint y0, gint width, gint height)
+/*
+ * Midpoint ellipse b^2 x^2 + a^2 y^2 = a^2 b^2 in the first quadrant.
+ * Region 1 (slope above -1) has one pixel per column x: the largest y
+ * with the midpoint (x, y - 1/2) inside the ellipse. Region 2 has one
+ * pixel per row y, moving at most one column per row; past the few
+ * rows where it joins region 1 that is the largest x with (x - 1/2, y)
+ * inside. Pixels of both regions have closed forms and are monotone,
+ * so the pixels of an arc inside any box are found by binary search
+ * and only they are walked, with 64-bit incremental error terms.
+ */
+static gint
+ellipse_region1_y(const Conic *ellipse, gint x)
 {
-	GList *list;
+	return midpoint_root(ellipse->a2, ellipse->k - 4 * ellipse->b2 * x * x);
+}
+
+static gint
+ellipse_row_x(const Conic *ellipse, gint y)
+{
+	return midpoint_root(ellipse->b2, ellipse->k - 4 * ellipse->a2 * y * y);
+}
+
+static gint
+ellipse_region2_x(const Conic *ellipse, gint y)
+{
+	gint x, row;
+
+	if (y < ellipse->yj) {
+		return MIN(ellipse->xj + ellipse->yj - y, ellipse_row_x(ellipse, y));
+	}
+
+	x = ellipse->xe;
+	for (row = ellipse->ye - 1; row >= y; --row) {
+		x = MIN(x + 1, ellipse_row_x(ellipse, row));
+	}
+
+	return x;
+}
+
+// Ends of region 1 and of the rows joining it. Past x^2 (a^2 + b^2) = a^4
+// the slope is below -1, past y^2 (a^2 + b^2) = b^4 it is above -1
+static void
+init_ellipse_regions(Conic *ellipse)
+{
+	gint64 s;
 	gint x, y;
-	gint e1, e2, e3;
-	gboolean in_zone;
 
-	list = NULL;
+	s = ellipse->a2 + ellipse->b2;
+
+	x = (gint) (ellipse->a2 / sqrt((gdouble) s));
+	while (x > 0 && SQR((gint64) x) * s >= SQR(ellipse->a2)) {
+		--x;
+	}
+	while (SQR((gint64) x + 1) * s < SQR(ellipse->a2)) {
+		++x;
+	}
+
+	// A flat arc does not leave the row y = 0 before its tip
+	if (ellipse_region1_y(ellipse, x) == 0) {
+		x = ellipse->a;
+	}
+
+	ellipse->xe = x;
+	ellipse->ye = ellipse_region1_y(ellipse, x);
+
+	y = (gint) (ellipse->b2 / sqrt((gdouble) s));
+	while (y > 0 && SQR((gint64) y) * s > SQR(ellipse->b2)) {
+		--y;
+	}
+	while (SQR((gint64) y + 1) * s <= SQR(ellipse->b2)) {
+		++y;
+	}
 
-	x = a;
-	y = 0;
+	ellipse->yj = MIN(y, ellipse->ye - 1);
+	ellipse->xj = ellipse->xe;
+	if (ellipse->yj >= 0) {
+		ellipse->xj = ellipse_region2_x(ellipse, ellipse->yj);
+	}
+}
+
+// Adds the region 1 pixels inside [xl, xh] x [yl, yh], mirrored by (sx, sy)
+static void
+add_ellipse_region1(GArray *figure, const Conic *ellipse, gint sx, gint sy,
+		gint xl, gint xh, gint yl, gint yh)
+{
+	gint64 t1, t2;
+	gint x, y, x_end;
 
-	add_pixel_in_zone(&list, x, y, x0, y0, width, height);
-	add_pixel_in_zone(&list, -x, y, x0, y0, width, height);
+	x = MAX(xl, search_below(ellipse, ellipse_region1_y, 0, ellipse->xe, yh + 1));
+	x_end = MIN(MIN(xh, ellipse->xe), search_below(ellipse, ellipse_region1_y, 0, ellipse->xe, yl) - 1);
+
+	if (x > x_end) {
+		return;
+	}
+
+	// t1 + t2 = 4 F(x, y - 1/2)
+	y = ellipse_region1_y(ellipse, x);
+	t1 = 4 * ellipse->b2 * x * x;
+	t2 = ellipse->a2 * SQR((gint64) 2 * y - 1);
 
 	while (TRUE) {
-		e1 = abs(SQR(x + 1) * SQR(b) - SQR(y + 1) * SQR(a) - SQR(a) * SQR(b));
-		e2 = abs(SQR(x + 1) * SQR(b) - SQR(y) * SQR(a) - SQR(a) * SQR(b));
-		e3 = abs(SQR(x) * SQR(b) - SQR(y + 1) * SQR(a) - SQR(a) * SQR(b));
+		add_pixel(figure, sx * x, sy * y);
+		if (x == x_end) {
+			break;
+		}
 
-		if (e1 < e2 && e1 < e3) {
-			++x;
-			++y;
-		} else if (e2 < e3) {
+		++x;
+		t1 += 4 * ellipse->b2 * (2 * x - 1);
+
+		while (y > 0 && t1 + t2 > ellipse->k) {
+			t2 -= 8 * ellipse->a2 * (y - 1);
+			--y;
+		}
+	}
+}
+
+// Adds the region 2 pixels inside [xl, xh] x [yl, yh], mirrored by (sx, sy)
+static void
+add_ellipse_region2(GArray *figure, const Conic *ellipse, gint sx, gint sy,
+		gint xl, gint xh, gint yl, gint yh)
+{
+	gint64 u1, u2;
+	gint x, y, y_end;
+
+	yl = MAX(yl, 0);
+	yh = MIN(yh, ellipse->ye - 1);
+	if (yl > yh) {
+		return;
+	}
+
+	y = MIN(yh, search_below(ellipse, ellipse_region2_x, yl, yh, xl) - 1);
+	y_end = MAX(yl, search_below(ellipse, ellipse_region2_x, yl, yh, xh + 1));
+
+	if (y < y_end) {
+		return;
+	}
+
+	// u1 + u2 = 4 F(x + 1/2, y)
+	x = ellipse_region2_x(ellipse, y);
+	u1 = ellipse->b2 * SQR((gint64) 2 * x + 1);
+	u2 = 4 * ellipse->a2 * y * y;
+
+	while (TRUE) {
+		add_pixel(figure, sx * x, sy * y);
+		if (y == y_end) {
+			break;
+		}
+
+		--y;
+		u2 -= 4 * ellipse->a2 * (2 * y + 1);
+
+		if (u1 + u2 <= ellipse->k) {
 			++x;
-		} else {
-			++y;
+			u1 += 8 * ellipse->b2 * x;
+		}
+	}
+}
+
+GArray *get_ellipse_figure(gint a, gint b, gint x0, gint y0, gint width, gint height)
+{
+	static const gint signs[4][2] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+	GArray *figure;
+	Conic ellipse;
+	gint x1, y1, x2, y2;
+	gint sx, sy, xl, xh, yl, yh;
+	gint i;
+
+	g_return_val_if_fail(a <= ELLIPSE_MAX_AXIS && b <= ELLIPSE_MAX_AXIS, figure_new(0));
+
+	figure = figure_new(0);
+
+	if (a < 1 || b < 1) {
+		return figure;
+	}
+
+	// The ellipse lies inside the axes, which keeps the zone in gint range
+	x1 = CLAMP(x0, - ELLIPSE_MAX_AXIS - 1, ELLIPSE_MAX_AXIS + 1);
+	y1 = CLAMP(y0, - ELLIPSE_MAX_AXIS - 1, ELLIPSE_MAX_AXIS + 1);
+	x2 = CLAMP((gint64) x0 + width, - ELLIPSE_MAX_AXIS - 1, ELLIPSE_MAX_AXIS + 1);
+	y2 = CLAMP((gint64) y0 + height, - ELLIPSE_MAX_AXIS - 1, ELLIPSE_MAX_AXIS + 1);
+
+	ellipse.a = a;
+	ellipse.b = b;
+	ellipse.a2 = (gint64) a * a;
+	ellipse.b2 = (gint64) b * b;
+	ellipse.k = 4 * ellipse.a2 * ellipse.b2;
+	init_ellipse_regions(&ellipse);
+
+	// Quadrants share the pixels on the axes, mirrored ones skip them
+	for (i = 0; i < 4; ++i) {
+		sx = signs[i][0];
+		sy = signs[i][1];
+
+		xl = sx > 0 ? MAX(x1, 0) : MAX(- x2, 1);
+		xh = sx > 0 ? x2 : - x1;
+		yl = sy > 0 ? MAX(y1, 0) : MAX(- y2, 1);
+		yh = sy > 0 ? y2 : - y1;
+
+		if (xl > xh || yl > yh) {
+			continue;
 		}
 
-		in_zone = FALSE;
-		in_zone |= add_pixel_in_zone(&list, x, y, x0, y0, width, height);
-		in_zone |= add_pixel_in_zone(&list, x, -y, x0, y0, width, height);
-		in_zone |= add_pixel_in_zone(&list, -x, y, x0, y0, width, height);
-		in_zone |= add_pixel_in_zone(&list, -x, -y, x0, y0, width, height);
-		if (!in_zone) break;
+		add_ellipse_region1(figure, &ellipse, sx, sy, xl, xh, yl, yh);
+		add_ellipse_region2(figure, &ellipse, sx, sy, xl, xh, yl, yh);
 	}
 
-	return list;
+	return figure;
+}
+
+/*
+ * Midpoint hyperbola b^2 x^2 - a^2 y^2 = a^2 b^2 in the first quadrant.
+ * Region 1 starts at the vertex, where the branch is steeper than 1,
+ * with one pixel per row y: the largest x with the midpoint (x - 1/2, y)
+ * on the inner side. If a > b the branch flattens out, and region 2 has
+ * one pixel per column x, moving at most one row per column; past the
+ * few columns joining region 1 that is the largest y with (x, y - 1/2)
+ * on the inner side. As for the ellipse, only the pixels inside the
+ * zone are walked.
+ */
+static gint
+hyperbole_region1_x(const Conic *hyperbole, gint y)
+{
+	return midpoint_root(hyperbole->b2, hyperbole->k + 4 * hyperbole->a2 * y * y);
 }
 
-GList *get_ellipse_figure(gint a, gint b, gint x0, gint y0, gint width, gint height)
+static gint
+hyperbole_column_y(const Conic *hyperbole, gint x)
 {
-	GList *list;
+	return midpoint_root(hyperbole->a2, 4 * hyperbole->b2 * x * x - hyperbole->k);
+}
+
+static gint
+hyperbole_region2_y(const Conic *hyperbole, gint x)
+{
+	gint y, column;
+
+	if (x > hyperbole->xj) {
+		return MIN(hyperbole->yj + x - hyperbole->xj, hyperbole_column_y(hyperbole, x));
+	}
+
+	y = hyperbole->ye;
+	for (column = hyperbole->xe + 1; column <= x; ++column) {
+		y = MIN(y + 1, hyperbole_column_y(hyperbole, column));
+	}
+
+	return y;
+}
+
+// Ends of region 1 and of the columns joining it. The slope is 1
+// at y^2 (a^2 - b^2) = b^4, x^2 (a^2 - b^2) = a^4
+static void
+init_hyperbole_regions(Conic *hyperbole)
+{
+	gint64 s;
 	gint x, y;
-	gint e1, e2, e3;
-	gboolean in_zone;
-
-	//TODO more correct condition
-	if (a > width && b > height) {
-		in_zone = FALSE;
-		in_zone &= SQR(x0) * SQR(b) + SQR(y0) * SQR(a) < SQR(a) * SQR(b);
-		in_zone &= SQR(x0 + width) * SQR(b) + SQR(y0) * SQR(a) < SQR(a) * SQR(b);
-		in_zone &= SQR(x0 + width) * SQR(b) + SQR(y0 + height) / SQR(a) < SQR(a) * SQR(b);
-		in_zone &= SQR(x0) * SQR(b) + SQR(y0 + height) * SQR(a) < SQR(a) * SQR(b);
-
-		if (!in_zone) {
-			return NULL;
-		}
+
+	s = hyperbole->a2 - hyperbole->b2;
+
+	if (s <= 0) {
+		hyperbole->ye = HYPERBOLE_MAX_COORDINATE;
+		hyperbole->xe = hyperbole_region1_x(hyperbole, hyperbole->ye);
+		hyperbole->xj = hyperbole->xe;
+		hyperbole->yj = hyperbole->ye;
+		return;
+	}
+
+	y = (gint) MIN(hyperbole->b2 / sqrt((gdouble) s), HYPERBOLE_MAX_COORDINATE);
+	while (y > 0 && SQR((gint64) y) * s > SQR(hyperbole->b2)) {
+		--y;
+	}
+	while (y < HYPERBOLE_MAX_COORDINATE && SQR((gint64) y + 1) * s <= SQR(hyperbole->b2)) {
+		++y;
+	}
+
+	hyperbole->ye = y;
+	hyperbole->xe = hyperbole_region1_x(hyperbole, y);
+
+	x = (gint) MIN(hyperbole->a2 / sqrt((gdouble) s), HYPERBOLE_MAX_COORDINATE);
+	while (x > 0 && SQR((gint64) x - 1) * s >= SQR(hyperbole->a2)) {
+		--x;
+	}
+	while (x < HYPERBOLE_MAX_COORDINATE && SQR((gint64) x) * s < SQR(hyperbole->a2)) {
+		++x;
 	}
 
-	list = NULL;
+	hyperbole->xj = MAX(x, hyperbole->xe + 1);
+	hyperbole->yj = hyperbole->ye;
+	hyperbole->yj = hyperbole_region2_y(hyperbole, hyperbole->xj);
+}
+
+// Adds the region 1 pixels inside [xl, xh] x [yl, yh], mirrored by (sx, sy)
+static void
+add_hyperbole_region1(GArray *figure, const Conic *hyperbole, gint sx, gint sy,
+		gint xl, gint xh, gint yl, gint yh)
+{
+	gint64 v1, v2;
+	gint x, y, y_end;
 
-	x = 0;
-	y = b;
+	yl = MAX(yl, 0);
+	yh = MIN(yh, hyperbole->ye);
+	if (yl > yh) {
+		return;
+	}
 
-	add_pixel_in_zone(&list, 0, b, x0, y0, width, height);
-	add_pixel_in_zone(&list, 0, -b, x0, y0, width, height);
+	y = search_above(hyperbole, hyperbole_region1_x, yl, yh, xl - 1);
+	y_end = search_above(hyperbole, hyperbole_region1_x, yl, yh, xh) - 1;
+
+	if (y > y_end) {
+		return;
+	}
+
+	// v1 - v2 = 4 F(x + 1/2, y)
+	x = hyperbole_region1_x(hyperbole, y);
+	v1 = hyperbole->b2 * SQR((gint64) 2 * x + 1);
+	v2 = hyperbole->k + 4 * hyperbole->a2 * y * y;
 
 	while (TRUE) {
-		e1 = abs(SQR(x + 1) * SQR(b) + SQR(y - 1) * SQR(a) - SQR(a) * SQR(b));
-		e2 = abs(SQR(x + 1) * SQR(b) + SQR(y) * SQR(a) - SQR(a) * SQR(b));
-		e3 = abs(SQR(x) * SQR(b) + SQR(y - 1) * SQR(a) - SQR(a) * SQR(b));
+		add_pixel(figure, sx * x, sy * y);
+		if (y == y_end) {
+			break;
+		}
 
-		if (e1 < e2 && e1 < e3) {
-			++x;
-			--y;
-		} else if (e2 < e3) {
+		++y;
+		v2 += 4 * hyperbole->a2 * (2 * y - 1);
+
+		while (v1 <= v2) {
 			++x;
-		} else {
-			--y;
+			v1 += 8 * hyperbole->b2 * x;
+		}
+	}
+}
+
+// Adds the region 2 pixels inside [xl, xh] x [yl, yh], mirrored by (sx, sy)
+static void
+add_hyperbole_region2(GArray *figure, const Conic *hyperbole, gint sx, gint sy,
+		gint xl, gint xh, gint yl, gint yh)
+{
+	gint64 w1, w2;
+	gint x, y, x_end;
+
+	if (hyperbole->a2 <= hyperbole->b2) {
+		return;
+	}
+
+	xl = MAX(xl, hyperbole->xe + 1);
+	if (xl > xh) {
+		return;
+	}
+
+	x = search_above(hyperbole, hyperbole_region2_y, xl, xh, yl - 1);
+	x_end = search_above(hyperbole, hyperbole_region2_y, xl, xh, yh) - 1;
+
+	if (x > x_end) {
+		return;
+	}
+
+	// w2 - w1 = 4 F(x, y + 1/2)
+	y = hyperbole_region2_y(hyperbole, x);
+	w1 = hyperbole->a2 * SQR((gint64) 2 * y + 1);
+	w2 = 4 * hyperbole->b2 * x * x - hyperbole->k;
+
+	while (TRUE) {
+		add_pixel(figure, sx * x, sy * y);
+		if (x == x_end) {
+			break;
 		}
 
-		if (y == 0) break;
+		++x;
+		w2 += 4 * hyperbole->b2 * (2 * x - 1);
+
+		if (w1 <= w2) {
+			++y;
+			w1 += 8 * hyperbole->a2 * y;
+		}
+	}
+}
+
+GArray *get_hyperbole_figure(gint a, gint b, gint x0, gint y0, gint width, gint height)
+{
+	static const gint signs[4][2] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+	GArray *figure;
+	Conic hyperbole;
+	gint x1, y1, x2, y2;
+	gint sx, sy, xl, xh, yl, yh;
+	gint i;
+
+	g_return_val_if_fail(a <= HYPERBOLE_MAX_AXIS && b <= HYPERBOLE_MAX_AXIS, figure_new(0));
+
+	figure = figure_new(0);
 
-		add_pixel_in_zone(&list, x, y, x0, y0, width, height);
-		add_pixel_in_zone(&list, x, -y, x0, y0, width, height);
-		add_pixel_in_zone(&list, -x, y, x0, y0, width, height);
-		add_pixel_in_zone(&list, -x, -y, x0, y0, width, height);
+	if (a < 1 || b < 1) {
+		return figure;
 	}
 
-	add_pixel_in_zone(&list, a, 0, x0, y0, width, height);
-	add_pixel_in_zone(&list, -a, 0, x0, y0, width, height);
+	x1 = CLAMP(x0, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	y1 = CLAMP(y0, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	x2 = CLAMP((gint64) x0 + width, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	y2 = CLAMP((gint64) y0 + height, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
 
-	return list;
+	hyperbole.a = a;
+	hyperbole.b = b;
+	hyperbole.a2 = (gint64) a * a;
+	hyperbole.b2 = (gint64) b * b;
+	hyperbole.k = 4 * hyperbole.a2 * hyperbole.b2;
+	init_hyperbole_regions(&hyperbole);
+
+	// Both branches share the pixels on the x axis, mirrored ones skip them
+	for (i = 0; i < 4; ++i) {
+		sx = signs[i][0];
+		sy = signs[i][1];
+
+		xl = MAX(sx > 0 ? x1 : - x2, a);
+		xh = sx > 0 ? x2 : - x1;
+		yl = sy > 0 ? MAX(y1, 0) : MAX(- y2, 1);
+		yh = sy > 0 ? y2 : - y1;
+
+		if (xl > xh || yl > yh) {
+			continue;
+		}
+
+		add_hyperbole_region1(figure, &hyperbole, sx, sy, xl, xh, yl, yh);
+		add_hyperbole_region2(figure, &hyperbole, sx, sy, xl, xh, yl, yh);
+	}
+
+	return figure;
 }
 
 static mat4 b_spline = {
@@ -322,96 +879,205 @@ static mat4 hermit = {
 };
 
 
-GList *
-get_bezier_figure(GList *points, gdouble step)
+// Bezier control points of one coordinate of the cubic p m (t^3, t^2, t, 1)
+static void
+get_bezier_points(vec4 result, vec4 p, mat4 m)
 {
-	GList *figure;
-	gint x, y;
-	gdouble double_x, double_y;
-	vec4 result;
-	gdouble t;
-	Point *point;
-	vec4 array_x, array_y;
-	int i;
+	vec4 c;
 
-	for (i = 0; i < 4; ++i) {
-		point = points->data;
+	multiplication_vec4_mat4(c, p, m);
 
-		array_x[i] = point->x;
-		array_y[i] = point->y;
+	result[0] = c[3];
+	result[1] = c[3] + c[2] / 3;
+	result[2] = c[3] + (2 * c[2] + c[1]) / 3;
+	result[3] = c[0] + c[1] + c[2] + c[3];
+}
 
-		points = g_list_next(points);
+// Bound on the pixels moved per unit of t: the hodograph of a Bezier
+// curve lies in the hull of 3 (b[i + 1] - b[i])
+static gint
+get_bezier_steps(vec4 bx, vec4 by)
+{
+	gdouble speed;
+	gint i;
+
+	speed = 0;
+	for (i = 0; i < 3; ++i) {
+		speed = MAX(speed, fabs(bx[i + 1] - bx[i]));
+		speed = MAX(speed, fabs(by[i + 1] - by[i]));
+	}
+
+	return (gint) CLAMP(ceil(3 * speed), 1, CURVE_MAX_STEPS);
+}
+
+// Halves of a Bezier curve, split at t = 1/2 by de Casteljau
+static void
+split_bezier(vec4 b, vec4 left, vec4 right)
+{
+	gdouble b01, b12, b23, b012, b123;
+
+	b01 = (b[0] + b[1]) / 2;
+	b12 = (b[1] + b[2]) / 2;
+	b23 = (b[2] + b[3]) / 2;
+	b012 = (b01 + b12) / 2;
+	b123 = (b12 + b23) / 2;
+
+	left[0] = b[0];
+	left[1] = b01;
+	left[2] = b012;
+	left[3] = right[0] = (b012 + b123) / 2;
+	right[1] = b123;
+	right[2] = b23;
+	right[3] = b[3];
+}
+
+// Adds a pixel unless it repeats the last one
+static void
+add_curve_pixel(GArray *figure, gint x, gint y)
+{
+	Pixel *last;
+
+	if (figure->len > 0) {
+		last = &g_array_index(figure, Pixel, figure->len - 1);
+		if (last->x == x && last->y == y) {
+			return;
+		}
 	}
 
-	figure = NULL;
+	add_pixel(figure, x, y);
+}
 
-	for (t = 0; t < 1 + 1e-5; t += step) {
-		vec4 vec_t = {pow(t, 3), pow(t, 2), t, 1};
+/*
+ * Pixels of a Bezier curve. The curve is sampled at steps short enough
+ * to move at most one pixel along each axis, so consecutive pixels
+ * touch; repeated pixels are dropped. Halves whose speed bounds are
+ * much lower than the whole are sampled separately, which keeps
+ * curves with uneven speed from being oversampled. Samples are
+ * evaluated by forward differences.
+ */
+static void
+add_bezier_pixels(GArray *figure, vec4 bx, vec4 by, gint depth)
+{
+	vec4 left_x, left_y, right_x, right_y;
+	gdouble x[4], y[4];
+	gdouble h, h2, h3;
+	gint count, i;
 
-		multiplication_mat4_vec4(result, bezier, vec_t);
-		multiplication_vec4_vec4(&double_x, array_x, result);
-		multiplication_vec4_vec4(&double_y, array_y, result);
+	count = get_bezier_steps(bx, by);
 
-		x = round(double_x);
-		y = round(double_y);
+	if (depth > 0 && count > CURVE_SPLIT_STEPS) {
+		split_bezier(bx, left_x, right_x);
+		split_bezier(by, left_y, right_y);
 
-		add_pixel(&figure, x, y);
+		if (4 * (get_bezier_steps(left_x, left_y) + get_bezier_steps(right_x, right_y)) < 3 * count) {
+			add_bezier_pixels(figure, left_x, left_y, depth - 1);
+			add_bezier_pixels(figure, right_x, right_y, depth - 1);
+			return;
+		}
 	}
 
-	return figure;
+	h = 1.0 / count;
+	h2 = h * h;
+	h3 = h2 * h;
+
+	// Value and first three differences of c0 t^3 + c1 t^2 + c2 t + c3,
+	// with c0 = b3 - 3 b2 + 3 b1 - b0, c1 = 3 (b2 - 2 b1 + b0), c2 = 3 (b1 - b0)
+	x[0] = bx[0];
+	x[3] = 6 * (bx[3] - 3 * bx[2] + 3 * bx[1] - bx[0]) * h3;
+	x[2] = x[3] + 6 * (bx[2] - 2 * bx[1] + bx[0]) * h2;
+	x[1] = x[3] / 6 + 3 * (bx[2] - 2 * bx[1] + bx[0]) * h2 + 3 * (bx[1] - bx[0]) * h;
+	y[0] = by[0];
+	y[3] = 6 * (by[3] - 3 * by[2] + 3 * by[1] - by[0]) * h3;
+	y[2] = y[3] + 6 * (by[2] - 2 * by[1] + by[0]) * h2;
+	y[1] = y[3] / 6 + 3 * (by[2] - 2 * by[1] + by[0]) * h2 + 3 * (by[1] - by[0]) * h;
+
+	for (i = 0; i < count; ++i) {
+		add_curve_pixel(figure, round(x[0]), round(y[0]));
+
+		x[0] += x[1];
+		x[1] += x[2];
+		x[2] += x[3];
+		y[0] += y[1];
+		y[1] += y[2];
+		y[2] += y[3];
+	}
+
+	// The end point exactly, without the drift of the differences
+	add_curve_pixel(figure, round(bx[3]), round(by[3]));
 }
 
-GList *get_hermitian_figure(GList *points, gdouble step)
+// Pixels of the cubic (x, y) = (px, py) m (t^3, t^2, t, 1) / scale
+static void
+add_cubic_pixels(GArray *figure, mat4 m, vec4 px, vec4 py, gdouble scale)
+{
+	vec4 bx, by;
+	gint i;
+
+	get_bezier_points(bx, px, m);
+	get_bezier_points(by, py, m);
+
+	for (i = 0; i < 4; ++i) {
+		bx[i] /= scale;
+		by[i] /= scale;
+	}
+
+	add_bezier_pixels(figure, bx, by, CURVE_MAX_DEPTH);
+}
+
+// Reads the four control points of a Bezier or Hermitian curve
+static void
+get_control_points(GList *points, vec4 px, vec4 py)
 {
-	GList *figure;
-	gint x, y;
-	gdouble double_x, double_y;
-	vec4 result;
-	gdouble t;
 	Point *point;
-	vec4 array_x, array_y;
-	int i;
+	gint i;
 
 	for (i = 0; i < 4; ++i) {
 		point = points->data;
 
-		array_x[i] = point->x;
-		array_y[i] = point->y;
+		px[i] = point->x;
+		py[i] = point->y;
 
 		points = g_list_next(points);
 	}
+}
 
-	figure = NULL;
+GArray *
+get_bezier_figure(GList *points)
+{
+	GArray *figure;
+	vec4 array_x, array_y;
 
-	for (t = 0; t < 1 + 1e-5; t += step) {
-		vec4 vec_t = {pow(t, 3), pow(t, 2), t, 1};
+	get_control_points(points, array_x, array_y);
 
-		multiplication_mat4_vec4(result, hermit, vec_t);
-		multiplication_vec4_vec4(&double_x, array_x, result);
-		multiplication_vec4_vec4(&double_y, array_y, result);
+	figure = figure_new(0);
+	add_cubic_pixels(figure, bezier, array_x, array_y, 1);
 
-		x = round(double_x);
-		y = round(double_y);
+	return figure;
+}
 
-		add_pixel(&figure, x, y);
-	}
+GArray *get_hermitian_figure(GList *points)
+{
+	GArray *figure;
+	vec4 array_x, array_y;
+
+	get_control_points(points, array_x, array_y);
+
+	figure = figure_new(0);
+	add_cubic_pixels(figure, hermit, array_x, array_y, 1);
 
 	return figure;
 }
-GList *
-get_b_spline_figure(GList *points, gdouble step)
+
+GArray *
+get_b_spline_figure(GList *points)
 {
-	GList *figure;
+	GArray *figure;
     Point *point;
-    gdouble t;
     gint i;
-    gint x, y;
-    gdouble double_x, double_y;
-    vec4 result;
     gint n;
 
     n = g_list_length(points);
-	figure  = NULL;
+	figure = figure_new(0);
 
     gdouble array[2][n + 4];
 
@@ -430,19 +1096,63 @@ get_b_spline_figure(GList *points, gdouble step)
 
 
 	for (i = 1; i <= n + 1; ++i) {
-		for (t = 0; t < 1 + 1e-5; t += step) {
-			vec4 vec_t = {pow(t, 3), pow(t, 2), t, 1};
+		add_cubic_pixels(figure, b_spline, array[0] + i - 1, array[1] + i - 1, 6);
+	}
 
-            multiplication_mat4_vec4(result, b_spline, vec_t);
-            multiplication_vec4_vec4(&double_x, array[0] + i - 1, result);
-            multiplication_vec4_vec4(&double_y, array[1] + i - 1, result);
+	return figure;
+}
 
-			x = round(double_x / 6);
-			y = round(double_y / 6);
+static mat4 *const cubic_matrices[] = {
+	[CUBIC_BEZIER] = &bezier,
+	[CUBIC_HERMITIAN] = &hermit,
+	[CUBIC_B_SPLINE] = &b_spline
+};
 
-			add_pixel(&figure, x, y);
-		}
+static const gdouble cubic_scales[] = {
+	[CUBIC_BEZIER] = 1,
+	[CUBIC_HERMITIAN] = 1,
+	[CUBIC_B_SPLINE] = 6
+};
+
+GArray *
+get_cubic_figure(CubicForm form, const gint *points)
+{
+	GArray *figure;
+	vec4 array_x, array_y;
+	gint i;
+
+	for (i = 0; i < 4; ++i) {
+		array_x[i] = points[2 * i];
+		array_y[i] = points[2 * i + 1];
 	}
 
+	figure = figure_new(0);
+	add_cubic_pixels(figure, *cubic_matrices[form], array_x, array_y, cubic_scales[form]);
+
 	return figure;
 }
+
+// The curve lies in the hull of its Bezier control points
+void
+get_cubic_bounds(CubicForm form, const gint *points, Bounds *bounds)
+{
+	vec4 array_x, array_y, bx, by;
+	gint i;
+
+	for (i = 0; i < 4; ++i) {
+		array_x[i] = points[2 * i];
+		array_y[i] = points[2 * i + 1];
+	}
+
+	get_bezier_points(bx, array_x, *cubic_matrices[form]);
+	get_bezier_points(by, array_y, *cubic_matrices[form]);
+
+	bounds->x1 = bounds->y1 = G_MAXINT;
+	bounds->x2 = bounds->y2 = G_MININT;
+	for (i = 0; i < 4; ++i) {
+		bounds->x1 = MIN(bounds->x1, (gint) floor(bx[i] / cubic_scales[form]));
+		bounds->y1 = MIN(bounds->y1, (gint) floor(by[i] / cubic_scales[form]));
+		bounds->x2 = MAX(bounds->x2, (gint) ceil(bx[i] / cubic_scales[form]));
+		bounds->y2 = MAX(bounds->y2, (gint) ceil(by[i] / cubic_scales[form]));
+	}
+}
@@ -1,12 +1,21 @@
 #ifndef __DRAWING_PANE_UTILS_H
 #define __DRAWING_PANE_UTILS_H
 
+/*
+ * Public interface of the rasterizer library. It depends only on glib
+ * and libm, so it can be used without GTK and without a display.
+ *
+ * Coordinates are integer cells with the y axis pointing up.
+ */
+
 #include <glib.h>
 
 G_BEGIN_DECLS
 
 typedef struct _Pixel Pixel;
 typedef struct _Point Point;
+typedef struct _Segment Segment;
+typedef struct _Bounds Bounds;
 
 struct _Pixel {
 	gint x, y;
@@ -17,14 +26,100 @@ struct _Point {
 	gint x, y;
 };
 
-GList *get_dda_line_figure(gint x1, gint y1, gint x2, gint y2);
-GList *get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2);
-GList *get_wu_line_figure(gint x1, gint y1, gint x2, gint y2);
-GList *get_hyperbole_figure(gint a, gint b, gint x0, gint y0, gint width, gint height);
-GList *get_ellipse_figure(gint a, gint b, gint x0, gint y0, gint width, gint height);
-GList *get_b_spline_figure(GList *points, gdouble step);
-GList *get_bezier_figure(GList *points, gdouble step);
-GList *get_hermitian_figure(GList *points, gdouble step);
+/* Line from (x1, y1) to (x2, y2) */
+struct _Segment {
+	gint x1, y1, x2, y2;
+};
+
+/* Inclusive bounding box */
+struct _Bounds {
+	gint x1, y1, x2, y2;
+};
+
+/*
+ * Figures are contiguous GArrays of Pixel. They are created by
+ * the get_*_figure functions and released with figure_free().
+ */
+GArray *figure_new(guint reserved_size);
+void figure_free(GArray *figure);
+
+gboolean bounds_intersect(const Bounds *a, const Bounds *b);
+
+/*
+ * Blends a black figure into a premultiplied ARGB32 buffer (the layout
+ * of a cairo image surface). Pixel (x, y) lands on buffer cell
+ * (origin_x + x, origin_y - y). Only cells inside the clip rectangle,
+ * given in buffer cells, are written.
+ */
+void draw_figure_on_buffer(GArray *figure, guchar *data, gint stride,
+		gint origin_x, gint origin_y,
+		gint clip_x, gint clip_y, gint clip_width, gint clip_height);
+
+/* The same for n pixels of a figure, in order */
+void draw_pixels_on_buffer(const Pixel *pixels, guint n, guchar *data, gint stride,
+		gint origin_x, gint origin_y,
+		gint clip_x, gint clip_y, gint clip_width, gint clip_height);
+
+/*
+ * Fills a width x height block of the xRGB32 buffer dest with the
+ * premultiplied ARGB32 canvas src composited over white and magnified
+ * cell_size times; dest pixel (0, 0) shows magnified pixel (x, y).
+ * Unless net_size is 0, grey net lines net_size pixels wide are drawn
+ * centred on every cell border of the canvas.
+ */
+void draw_zoomed_buffer(const guchar *src, gint src_stride, gint src_width, gint src_height,
+		guchar *dest, gint dest_stride, gint x, gint y, gint width, gint height,
+		gint cell_size, gint net_size);
+
+/* Lines from (x1, y1) to (x2, y2). */
+GArray *get_dda_line_figure(gint x1, gint y1, gint x2, gint y2);
+GArray *get_bresenham_line_figure(gint x1, gint y1, gint x2, gint y2);
+GArray *get_wu_line_figure(gint x1, gint y1, gint x2, gint y2);
+
+/*
+ * Rasterize n lines at once with the widest SIMD kernels the CPU
+ * supports; figures[i] receives the same pixels as the single line
+ * function gives for segments[i].
+ */
+void get_dda_line_figures(const Segment *segments, guint n, GArray **figures);
+void get_bresenham_line_figures(const Segment *segments, guint n, GArray **figures);
+
+#define ELLIPSE_MAX_AXIS 30000
+#define HYPERBOLE_MAX_AXIS 10000
+#define HYPERBOLE_MAX_COORDINATE 100000
+
+/*
+ * Conics centered at the origin, clipped to the zone
+ * [x0, x0 + width] x [y0, y0 + height], which may be any rectangle.
+ * Only the pixels inside the zone are generated. The ellipse axes must
+ * not exceed 30000, the hyperbola axes 10000; the hyperbola is drawn
+ * no further than 100000 from the origin.
+ */
+GArray *get_hyperbole_figure(gint a, gint b, gint x0, gint y0, gint width, gint height);
+GArray *get_ellipse_figure(gint a, gint b, gint x0, gint y0, gint width, gint height);
+
+/*
+ * Cubic curves. points is a list of Point: any number of control points
+ * for the B-spline, exactly four for the Bezier and Hermitian forms.
+ * Consecutive pixels of a curve touch and are never the same pixel.
+ */
+GArray *get_b_spline_figure(GList *points);
+GArray *get_bezier_figure(GList *points);
+GArray *get_hermitian_figure(GList *points);
+
+typedef enum {
+	CUBIC_BEZIER,
+	CUBIC_HERMITIAN,
+	CUBIC_B_SPLINE
+} CubicForm;
+
+/*
+ * One cubic segment from x and y of its four control points, in the
+ * order of the list functions above. The bounds enclose every pixel
+ * of the figure without rasterizing it.
+ */
+GArray *get_cubic_figure(CubicForm form, const gint *points);
+void get_cubic_bounds(CubicForm form, const gint *points, Bounds *bounds);
 
 G_END_DECLS
 
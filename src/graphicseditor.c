@@ -1,5 +1,6 @@
 #include "graphicseditor.h"
 
+#include "drawingpane.h"
 #include "drawingpane_utils.h"
 #include "graphicseditorwin.h"
 
@@ -18,6 +19,18 @@ static void graphicseditor_set_actions(GraphicsEditor *app);
 static void graphicseditor_set_app_menu(GraphicsEditor *app);
 static void graphicseditor_quit(GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void graphicseditor_about(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_new_document(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_open_document(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_save_document(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_import_figures(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_export_document(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_close_window(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_undo(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void graphicseditor_redo(GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static DrawingPane *graphicseditor_get_drawing_pane(GraphicsEditor *app);
+static gchar *graphicseditor_choose_file(GraphicsEditor *app, GtkFileChooserAction action,
+		const gchar *title, const gchar *filter_name, const gchar *extension);
+static void graphicseditor_show_error(GraphicsEditor *app, GError *error);
 static void graphicseditor_changed_drawing_mode(GSettings *setting, GVariant *parameter, gpointer user_data);
 static void graphicseditor_change_drawing_mode(GSimpleAction *action, GVariant *parameter, gpointer user_data);
 
@@ -119,12 +132,211 @@ graphicseditor_about(GSimpleAction *action, GVariant *parameter, gpointer user_d
 
 }
 
+static DrawingPane *
+graphicseditor_get_drawing_pane(GraphicsEditor *app)
+{
+	return DRAWING_PANE(graphicseditor_window_get_drawing_pane(app->priv->window));
+}
+
+static void
+graphicseditor_new_document(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+
+	drawing_pane_new_document(graphicseditor_get_drawing_pane(GRAPHICSEDITOR(user_data)));
+}
+
+static void
+graphicseditor_open_document(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	GraphicsEditor *app;
+	GError *error;
+	gchar *filename;
+
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+	app = GRAPHICSEDITOR(user_data);
+
+	filename = graphicseditor_choose_file(app, GTK_FILE_CHOOSER_ACTION_OPEN, "Open drawing", "Drawings", "ged");
+	if (filename == NULL) {
+		return;
+	}
+
+	error = NULL;
+	if (!drawing_pane_load(graphicseditor_get_drawing_pane(app), filename, &error)) {
+		graphicseditor_show_error(app, error);
+		g_error_free(error);
+	}
+
+	g_free(filename);
+}
+
+static void
+graphicseditor_save_document(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	GraphicsEditor *app;
+	GError *error;
+	gchar *filename;
+
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+	app = GRAPHICSEDITOR(user_data);
+
+	filename = graphicseditor_choose_file(app, GTK_FILE_CHOOSER_ACTION_SAVE, "Save drawing", "Drawings", "ged");
+	if (filename == NULL) {
+		return;
+	}
+
+	error = NULL;
+	if (!drawing_pane_save(graphicseditor_get_drawing_pane(app), filename, &error)) {
+		graphicseditor_show_error(app, error);
+		g_error_free(error);
+	}
+
+	g_free(filename);
+}
+
+static void
+graphicseditor_import_figures(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	GraphicsEditor *app;
+	GError *error;
+	gchar *filename;
+
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+	app = GRAPHICSEDITOR(user_data);
+
+	filename = graphicseditor_choose_file(app, GTK_FILE_CHOOSER_ACTION_OPEN, "Import figures", NULL, NULL);
+	if (filename == NULL) {
+		return;
+	}
+
+	error = NULL;
+	if (!drawing_pane_import(graphicseditor_get_drawing_pane(app), filename, &error)) {
+		graphicseditor_show_error(app, error);
+		g_error_free(error);
+	}
+
+	g_free(filename);
+}
+
+static void
+graphicseditor_export_document(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	GraphicsEditor *app;
+	GError *error;
+	gchar *filename;
+
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+	app = GRAPHICSEDITOR(user_data);
+
+	filename = graphicseditor_choose_file(app, GTK_FILE_CHOOSER_ACTION_SAVE, "Export drawing", "PNG images", "png");
+	if (filename == NULL) {
+		return;
+	}
+
+	error = NULL;
+	if (!drawing_pane_export(graphicseditor_get_drawing_pane(app), filename, &error)) {
+		graphicseditor_show_error(app, error);
+		g_error_free(error);
+	}
+
+	g_free(filename);
+}
+
+static void
+graphicseditor_close_window(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+
+	gtk_window_close(GTK_WINDOW(GRAPHICSEDITOR(user_data)->priv->window));
+}
+
+static void
+graphicseditor_undo(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+
+	drawing_pane_undo(graphicseditor_get_drawing_pane(GRAPHICSEDITOR(user_data)));
+}
+
+static void
+graphicseditor_redo(GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	g_return_if_fail(GRAPHICSEDITOR_IS_INSTANCE(user_data));
+
+	drawing_pane_redo(graphicseditor_get_drawing_pane(GRAPHICSEDITOR(user_data)));
+}
+
+// Returns the chosen file name, NULL if the dialog was cancelled.
+// Only files with the extension are shown, all files if it is NULL
+static gchar *
+graphicseditor_choose_file(GraphicsEditor *app, GtkFileChooserAction action,
+		const gchar *title, const gchar *filter_name, const gchar *extension)
+{
+	GtkWidget *dialog;
+	GtkFileFilter *filter;
+	gchar *filename, *name;
+
+	dialog = gtk_file_chooser_dialog_new(title,
+			GTK_WINDOW(app->priv->window),
+			action,
+			"Cancel", GTK_RESPONSE_CANCEL,
+			action == GTK_FILE_CHOOSER_ACTION_OPEN ? "Open" : "Save", GTK_RESPONSE_ACCEPT,
+			NULL);
+
+	if (extension != NULL) {
+		name = g_strdup_printf("*.%s", extension);
+		filter = gtk_file_filter_new();
+		gtk_file_filter_set_name(filter, filter_name);
+		gtk_file_filter_add_pattern(filter, name);
+		gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+		g_free(name);
+	}
+
+	if (action == GTK_FILE_CHOOSER_ACTION_SAVE && extension != NULL) {
+		name = g_strdup_printf("Untitled.%s", extension);
+		gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+		gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), name);
+		g_free(name);
+	}
+
+	filename = NULL;
+	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+	}
+	gtk_widget_destroy(dialog);
+
+	return filename;
+}
+
+static void
+graphicseditor_show_error(GraphicsEditor *app, GError *error)
+{
+	GtkWidget *dialog;
+
+	dialog = gtk_message_dialog_new(GTK_WINDOW(app->priv->window),
+			GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_MESSAGE_ERROR,
+			GTK_BUTTONS_CLOSE,
+			"%s", error->message);
+
+	gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+}
+
 static void
 graphicseditor_set_accelerator(GraphicsEditor *app)
 {
 	GVariant *va;
 
 	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>q", "app.quit", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>n", "app.new", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>o", "app.open", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>s", "app.save", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>i", "app.import", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>e", "app.export", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>w", "app.close", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary>z", "app.undo", NULL);
+	gtk_application_add_accelerator (GTK_APPLICATION (app), "<Primary><Shift>z", "app.redo", NULL);
 	gtk_application_add_accelerator (GTK_APPLICATION (app), "F7", "app.about", NULL);
 
 	va = g_variant_new_string("none");
@@ -170,6 +382,14 @@ graphicseditor_set_actions(GraphicsEditor *app)
 {
 	GSimpleAction *quit;
 	GSimpleAction *about;
+	GSimpleAction *new;
+	GSimpleAction *open;
+	GSimpleAction *save;
+	GSimpleAction *import;
+	GSimpleAction *export;
+	GSimpleAction *close;
+	GSimpleAction *undo;
+	GSimpleAction *redo;
 
 	quit = g_simple_action_new("quit", NULL);
 	g_signal_connect(quit,
@@ -187,6 +407,70 @@ graphicseditor_set_actions(GraphicsEditor *app)
 	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(about));
 	g_object_unref(about);
 
+	new = g_simple_action_new("new", NULL);
+	g_signal_connect(new,
+			"activate",
+			G_CALLBACK(graphicseditor_new_document),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(new));
+	g_object_unref(new);
+
+	open = g_simple_action_new("open", NULL);
+	g_signal_connect(open,
+			"activate",
+			G_CALLBACK(graphicseditor_open_document),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(open));
+	g_object_unref(open);
+
+	save = g_simple_action_new("save", NULL);
+	g_signal_connect(save,
+			"activate",
+			G_CALLBACK(graphicseditor_save_document),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(save));
+	g_object_unref(save);
+
+	import = g_simple_action_new("import", NULL);
+	g_signal_connect(import,
+			"activate",
+			G_CALLBACK(graphicseditor_import_figures),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(import));
+	g_object_unref(import);
+
+	export = g_simple_action_new("export", NULL);
+	g_signal_connect(export,
+			"activate",
+			G_CALLBACK(graphicseditor_export_document),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(export));
+	g_object_unref(export);
+
+	close = g_simple_action_new("close", NULL);
+	g_signal_connect(close,
+			"activate",
+			G_CALLBACK(graphicseditor_close_window),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(close));
+	g_object_unref(close);
+
+	undo = g_simple_action_new("undo", NULL);
+	g_signal_connect(undo,
+			"activate",
+			G_CALLBACK(graphicseditor_undo),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(undo));
+	g_object_unref(undo);
+
+	redo = g_simple_action_new("redo", NULL);
+	g_signal_connect(redo,
+			"activate",
+			G_CALLBACK(graphicseditor_redo),
+			app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(redo));
+	g_object_unref(redo);
+
 	app->priv->drawing_mode = g_simple_action_new_stateful(
 			"drawing-mode",
 			G_VARIANT_TYPE_STRING,
@@ -214,6 +498,10 @@ graphicseditor_set_app_menu(GraphicsEditor *app)
 
 	section = g_menu_new();
 	g_menu_append(section, "New", "app.new");
+	g_menu_append(section, "Open", "app.open");
+	g_menu_append(section, "Save", "app.save");
+	g_menu_append(section, "Import", "app.import");
+	g_menu_append(section, "Export", "app.export");
 	g_menu_append(section, "Close", "app.close");
 	g_menu_append_section(submenu, NULL, G_MENU_MODEL(section));
 	g_object_unref(section);
@@ -226,6 +514,12 @@ graphicseditor_set_app_menu(GraphicsEditor *app)
 	g_menu_append_submenu(menu, "File", G_MENU_MODEL(submenu));
 	g_object_unref(submenu);
 
+	submenu = g_menu_new();
+	g_menu_append(submenu, "Undo", "app.undo");
+	g_menu_append(submenu, "Redo", "app.redo");
+	g_menu_append_submenu(menu, "Edit", G_MENU_MODEL(submenu));
+	g_object_unref(submenu);
+
 	submenu = g_menu_new();
 
 	section = g_menu_new();
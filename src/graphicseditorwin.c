@@ -11,6 +11,9 @@ struct _GraphicsEditorWindowPrivate
 	GtkFrame *working_area;
 	GraphicsEditorDrawingModeType drawing_mode;
 	GtkLabel *statusbar;
+	gint cursor_x, cursor_y;
+	guint statusbar_tick; // pending statusbar update, 0 if none
+	gchar statusbar_text[64];
 };
 
 enum
@@ -23,7 +26,7 @@ static void graphicseditor_window_finalize(GObject *object);
 static void graphicseditor_window_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 static void graphicseditor_window_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void graphicseditor_window_set_toolpalette(GraphicsEditorWindow *win);
-static void graphicseditor_window_cursor_changed(GObject *object, GParamSpec *spec, gpointer user_data);
+static void graphicseditor_window_cursor_changed(DrawingPane *pane, gint x, gint y, gpointer user_data);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE(GraphicsEditorWindow, graphicseditor_window, GTK_TYPE_APPLICATION_WINDOW);
@@ -184,12 +187,7 @@ graphicseditor_window_constructed(GObject *object)
 	gtk_container_add(GTK_CONTAINER(priv->working_area), GTK_WIDGET(priv->drawing_area));
 
 	g_signal_connect(priv->drawing_area,
-			"notify::cursor-x",
-			G_CALLBACK(graphicseditor_window_cursor_changed),
-			win);
-
-	g_signal_connect(priv->drawing_area,
-			"notify::cursor-y",
+			"cursor-changed",
 			G_CALLBACK(graphicseditor_window_cursor_changed),
 			win);
 
@@ -206,21 +204,35 @@ graphicseditor_window_finalize(GObject *object)
 		G_OBJECT_CLASS (graphicseditor_window_parent_class)->finalize(object);
 }
 
-static void graphicseditor_window_cursor_changed(GObject *object, GParamSpec *spec, gpointer user_data)
+static gboolean
+graphicseditor_window_update_statusbar(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
 {
 	GraphicsEditorWindowPrivate *priv;
 
 	priv = GRAPHICSEDITOR_WINDOW(user_data)->priv;
+	priv->statusbar_tick = 0;
 
-	gint x, y;
+	g_snprintf(priv->statusbar_text, sizeof(priv->statusbar_text),
+			"Coordinates: %d, %d", priv->cursor_x, priv->cursor_y);
+	gtk_label_set_label(GTK_LABEL(priv->statusbar), priv->statusbar_text);
 
-	g_object_get(priv->drawing_area,
-			"cursor-x", &x,
-			"cursor-y", &y,
-			NULL
-	);
+	return G_SOURCE_REMOVE;
+}
+
+// The statusbar shows the last cursor position once per frame
+static void graphicseditor_window_cursor_changed(DrawingPane *pane, gint x, gint y, gpointer user_data)
+{
+	GraphicsEditorWindowPrivate *priv;
 
-	gtk_label_set_label(GTK_LABEL(priv->statusbar), g_strdup_printf("Coordinates: %d, %d", x, y));
+	priv = GRAPHICSEDITOR_WINDOW(user_data)->priv;
+
+	priv->cursor_x = x;
+	priv->cursor_y = y;
+
+	if (priv->statusbar_tick == 0) {
+		priv->statusbar_tick = gtk_widget_add_tick_callback(GTK_WIDGET(priv->statusbar),
+				graphicseditor_window_update_statusbar, user_data, NULL);
+	}
 }
 
 
@@ -231,3 +243,9 @@ graphicseditor_window_new (GraphicsEditor *app)
 			"application", app,
 			NULL);
 }
+
+GtkWidget *
+graphicseditor_window_get_drawing_pane (GraphicsEditorWindow *win)
+{
+	return GTK_WIDGET(win->priv->drawing_area);
+}
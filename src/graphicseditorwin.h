@@ -31,6 +31,7 @@ struct _GraphicsEditorWindowClass
 GType graphicseditor_window_get_type (void);
 GraphicsEditorWindow *graphicseditor_window_new (GraphicsEditor *app);
 void graphicseditor_window_set_drawing_mode(GraphicsEditorWindow *app, gint mode);
+GtkWidget *graphicseditor_window_get_drawing_pane (GraphicsEditorWindow *win);
 
 G_END_DECLS
 
@@ -0,0 +1,410 @@
+#include "import.h"
+#include <string.h>
+
+#define IMPORT_CHUNK_SIZE (1 << 20) // least bytes parsed by one thread
+#define IMPORT_MAX_VALUE 1000000000 // larger numbers saturate to it
+
+typedef struct _ImportChunk ImportChunk;
+struct _ImportChunk {
+	const gchar *start, *end;
+	gboolean is_text;
+	gboolean is_first; // the chunk at the start of the file
+	SceneKind kind; // kind of the records without a kind name
+	GArray *kinds; // guint8 SceneKind of every record
+	GArray *params; // gint parameters of the figures, in order
+	GPtrArray *splines; // GList of the Point of every spline, in order
+	const gchar *error_at; // start of the first wrong record, NULL if none
+	const gchar *error_message;
+};
+
+static gboolean is_separator(gchar c);
+static const gchar *parse_number(const gchar *p, const gchar *end, gint *value);
+static void add_record(ImportChunk *chunk, SceneKind kind, const gint *values, guint n);
+static void parse_text_chunk(ImportChunk *chunk);
+static void parse_binary_chunk(ImportChunk *chunk);
+static gpointer parse_chunk(gpointer data);
+static void split_text(const gchar *data, gsize size, ImportChunk *chunks, guint n_chunks);
+static const gchar *split_binary(const gchar *data, gsize size, SceneKind kind,
+		ImportChunk *chunks, guint n_chunks, const gchar **message);
+static void add_chunk(Scene *scene, ImportChunk *chunk, GArray *ids);
+static void free_points(gpointer points);
+
+G_DEFINE_QUARK(import-error-quark, import_error)
+
+static gboolean
+is_separator(gchar c)
+{
+	return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r';
+}
+
+// Reads a decimal number rounded to the nearest integer. Returns the
+// end of the number, NULL if there is no number up to a separator
+static const gchar *
+parse_number(const gchar *p, const gchar *end, gint *value)
+{
+	gboolean negative, has_digits;
+	gint result;
+
+	negative = FALSE;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	result = 0;
+	has_digits = p < end && g_ascii_isdigit(*p);
+	for (; p < end && g_ascii_isdigit(*p); ++p) {
+		if (result <= (IMPORT_MAX_VALUE - (*p - '0')) / 10) {
+			result = result * 10 + (*p - '0');
+		} else {
+			result = IMPORT_MAX_VALUE;
+		}
+	}
+
+	if (p < end && *p == '.') {
+		++p;
+		has_digits = has_digits || (p < end && g_ascii_isdigit(*p));
+		if (p < end && *p >= '5' && *p <= '9' && result < IMPORT_MAX_VALUE) {
+			++result;
+		}
+		for (; p < end && g_ascii_isdigit(*p); ++p);
+	}
+
+	if (!has_digits || (p < end && !is_separator(*p))) {
+		return NULL;
+	}
+
+	*value = negative ? -result : result;
+
+	return p;
+}
+
+static void
+add_record(ImportChunk *chunk, SceneKind kind, const gint *values, guint n)
+{
+	guint8 value;
+	GList *points;
+	Point *point;
+
+	value = kind;
+	g_array_append_val(chunk->kinds, value);
+
+	if (scene_kinds[kind].get_segment_count == NULL) {
+		g_array_append_vals(chunk->params, values, n);
+		return;
+	}
+
+	points = NULL;
+	for (; n > 0; n -= 2) {
+		point = g_malloc(sizeof(Point));
+		point->x = values[n - 2];
+		point->y = values[n - 1];
+		points = g_list_prepend(points, point);
+	}
+	g_ptr_array_add(chunk->splines, points);
+}
+
+static void
+parse_text_chunk(ImportChunk *chunk)
+{
+	const gchar *line, *end, *p, *name;
+	const gchar *message;
+	gboolean is_first_line;
+	GArray *values;
+	SceneKind kind;
+	gint value;
+
+	values = g_array_new(FALSE, FALSE, sizeof(gint));
+	is_first_line = chunk->is_first;
+
+	for (line = chunk->start; line < chunk->end && chunk->error_at == NULL; line = end < chunk->end ? end + 1 : end) {
+		end = memchr(line, '\n', chunk->end - line);
+		if (end == NULL) {
+			end = chunk->end;
+		}
+
+		for (p = line; p < end && is_separator(*p); ++p);
+		if (p == end || *p == '#') {
+			continue;
+		}
+
+		kind = chunk->kind;
+		if (g_ascii_isalpha(*p)) {
+			for (name = p; p < end && !is_separator(*p); ++p);
+			kind = scene_kind_from_name(name, p - name);
+		}
+
+		if (kind == SCENE_KIND_NONE) {
+			// Column names
+			if (is_first_line) {
+				is_first_line = FALSE;
+				continue;
+			}
+			chunk->error_at = line;
+			chunk->error_message = "unknown figure kind";
+			break;
+		}
+		is_first_line = FALSE;
+
+		g_array_set_size(values, 0);
+		message = NULL;
+		while (message == NULL) {
+			for (; p < end && is_separator(*p); ++p);
+			if (p == end) {
+				message = scene_check_values(kind, (const gint *) values->data, values->len);
+				break;
+			}
+
+			p = parse_number(p, end, &value);
+			if (p == NULL) {
+				message = "not a number";
+			} else {
+				g_array_append_val(values, value);
+			}
+		}
+
+		if (message != NULL) {
+			chunk->error_at = line;
+			chunk->error_message = message;
+		} else {
+			add_record(chunk, kind, (const gint *) values->data, values->len);
+		}
+	}
+
+	g_array_free(values, TRUE);
+}
+
+// Records are checked as a whole by split_binary()
+static void
+parse_binary_chunk(ImportChunk *chunk)
+{
+	const gchar *p;
+	const gint32 *values;
+	guint n;
+
+	for (p = chunk->start; p < chunk->end && chunk->error_at == NULL; p = (const gchar *) (values + n)) {
+		values = (const gint32 *) p;
+		if (scene_kinds[chunk->kind].get_segment_count == NULL) {
+			n = scene_kinds[chunk->kind].n_params;
+		} else {
+			n = 2 * values[0];
+			++values;
+		}
+
+		chunk->error_message = scene_check_values(chunk->kind, values, n);
+		if (chunk->error_message != NULL) {
+			chunk->error_at = p;
+		} else {
+			add_record(chunk, chunk->kind, values, n);
+		}
+	}
+}
+
+static gpointer
+parse_chunk(gpointer data)
+{
+	ImportChunk *chunk = data;
+
+	if (chunk->is_text) {
+		parse_text_chunk(chunk);
+	} else {
+		parse_binary_chunk(chunk);
+	}
+
+	return NULL;
+}
+
+// Chunks start at the beginning of a line
+static void
+split_text(const gchar *data, gsize size, ImportChunk *chunks, guint n_chunks)
+{
+	const gchar *start;
+	gsize offset;
+	guint i;
+
+	chunks[0].start = data;
+	for (i = 1; i < n_chunks; ++i) {
+		offset = size / n_chunks * i;
+		start = memchr(data + offset - 1, '\n', size - offset + 1);
+		chunks[i].start = start != NULL ? start + 1 : data + size;
+		chunks[i - 1].end = chunks[i].start;
+	}
+	chunks[n_chunks - 1].end = data + size;
+}
+
+// Chunks start at the beginning of a record. Returns the first record
+// that does not fit the file, NULL if there is none
+static const gchar *
+split_binary(const gchar *data, gsize size, SceneKind kind,
+		ImportChunk *chunks, guint n_chunks, const gchar **message)
+{
+	gsize record_size, n_records, offset;
+	gint32 n_points;
+	guint i;
+
+	*message = "the record does not fit the file";
+
+	if (scene_kinds[kind].get_segment_count == NULL) {
+		record_size = scene_kinds[kind].n_params * sizeof(gint32);
+		n_records = size / record_size;
+		if (n_records * record_size != size) {
+			return data + n_records * record_size;
+		}
+
+		for (i = 0; i < n_chunks; ++i) {
+			chunks[i].start = data + n_records / n_chunks * i * record_size;
+			chunks[i].end = data + (i + 1 < n_chunks ? n_records / n_chunks * (i + 1) : n_records) * record_size;
+		}
+		return NULL;
+	}
+
+	// Splines have records of their own size, which are only walked here
+	chunks[0].start = data;
+	for (i = 0, offset = 0; offset < size; offset += sizeof(gint32) + 2 * (gsize) n_points * sizeof(gint32)) {
+		if (size - offset < sizeof(gint32)) {
+			return data + offset;
+		}
+
+		n_points = *(const gint32 *) (data + offset);
+		if (n_points <= 0 || (gsize) n_points > (size - offset - sizeof(gint32)) / (2 * sizeof(gint32))) {
+			*message = n_points <= 0 ? "wrong number of control points" : *message;
+			return data + offset;
+		}
+
+		if (i + 1 < n_chunks && offset >= size / n_chunks * (i + 1)) {
+			chunks[i].end = chunks[i + 1].start = data + offset;
+			++i;
+		}
+	}
+
+	for (; i + 1 < n_chunks; ++i) {
+		chunks[i].end = chunks[i + 1].start = data + size;
+	}
+	chunks[n_chunks - 1].end = data + size;
+
+	return NULL;
+}
+
+static void
+add_chunk(Scene *scene, ImportChunk *chunk, GArray *ids)
+{
+	const gint *params;
+	SceneKind kind;
+	guint i, j, id;
+
+	params = (const gint *) chunk->params->data;
+	for (i = 0, j = 0; i < chunk->kinds->len; ++i) {
+		kind = g_array_index(chunk->kinds, guint8, i);
+		if (scene_kinds[kind].get_segment_count == NULL) {
+			id = scene_add_figure(scene, kind, params);
+			params += scene_kinds[kind].n_params;
+		} else {
+			id = scene_add_spline(scene, kind, g_ptr_array_index(chunk->splines, j));
+			++j;
+		}
+
+		if (ids != NULL) {
+			g_array_append_val(ids, id);
+		}
+	}
+
+	// The scene owns the points now
+	g_ptr_array_set_free_func(chunk->splines, NULL);
+}
+
+static void
+free_points(gpointer points)
+{
+	g_list_free_full(points, g_free);
+}
+
+gboolean
+import_file(Scene *scene, const gchar *filename, SceneKind kind, GArray *ids, GError **error)
+{
+	GMappedFile *file;
+	ImportChunk *chunks, *chunk;
+	GThread **threads;
+	const gchar *data, *error_at, *message, *p;
+	gchar *lower_name;
+	gboolean is_text;
+	gsize size;
+	guint n_chunks, line, i;
+
+	g_return_val_if_fail(kind > SCENE_KIND_NONE && kind < SCENE_N_KINDS, FALSE);
+
+	file = g_mapped_file_new(filename, FALSE, error);
+	if (file == NULL) {
+		return FALSE;
+	}
+
+	data = g_mapped_file_get_contents(file);
+	size = g_mapped_file_get_length(file);
+	if (size == 0) {
+		g_mapped_file_unref(file);
+		return TRUE;
+	}
+
+	lower_name = g_ascii_strdown(filename, -1);
+	is_text = g_str_has_suffix(lower_name, ".csv") || g_str_has_suffix(lower_name, ".txt");
+	g_free(lower_name);
+
+	n_chunks = CLAMP(size / IMPORT_CHUNK_SIZE, 1, g_get_num_processors());
+	chunks = g_new0(ImportChunk, n_chunks);
+	threads = g_new0(GThread *, n_chunks);
+
+	for (i = 0; i < n_chunks; ++i) {
+		chunks[i].is_text = is_text;
+		chunks[i].is_first = i == 0;
+		chunks[i].kind = kind;
+		chunks[i].kinds = g_array_new(FALSE, FALSE, sizeof(guint8));
+		chunks[i].params = g_array_new(FALSE, FALSE, sizeof(gint));
+		chunks[i].splines = g_ptr_array_new_with_free_func(free_points);
+	}
+
+	error_at = NULL;
+	if (is_text) {
+		split_text(data, size, chunks, n_chunks);
+	} else {
+		error_at = split_binary(data, size, kind, chunks, n_chunks, &message);
+	}
+
+	if (error_at == NULL) {
+		for (i = 1; i < n_chunks; ++i) {
+			threads[i] = g_thread_new("import", parse_chunk, &chunks[i]);
+		}
+		parse_chunk(&chunks[0]);
+		for (i = 1; i < n_chunks; ++i) {
+			g_thread_join(threads[i]);
+		}
+
+		for (i = 0; i < n_chunks && chunks[i].error_at == NULL; ++i);
+		if (i < n_chunks) {
+			error_at = chunks[i].error_at;
+			message = chunks[i].error_message;
+		}
+	}
+
+	if (error_at != NULL && is_text) {
+		for (line = 1, p = data; (p = memchr(p, '\n', error_at - p)) != NULL; ++p, ++line);
+		g_set_error(error, IMPORT_ERROR, IMPORT_ERROR_FORMAT, "Line %u: %s", line, message);
+	} else if (error_at != NULL) {
+		g_set_error(error, IMPORT_ERROR, IMPORT_ERROR_FORMAT, "Byte %" G_GSIZE_FORMAT ": %s",
+				(gsize) (error_at - data), message);
+	} else {
+		for (i = 0; i < n_chunks; ++i) {
+			add_chunk(scene, &chunks[i], ids);
+		}
+	}
+
+	for (i = 0; i < n_chunks; ++i) {
+		chunk = &chunks[i];
+		g_array_free(chunk->kinds, TRUE);
+		g_array_free(chunk->params, TRUE);
+		g_ptr_array_free(chunk->splines, TRUE);
+	}
+	g_free(threads);
+	g_free(chunks);
+	g_mapped_file_unref(file);
+
+	return error_at == NULL;
+}
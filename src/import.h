@@ -0,0 +1,40 @@
+#ifndef __IMPORT_H
+#define __IMPORT_H
+
+#include "scene.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Figures from survey data. Text files (*.csv, *.txt) have a figure per
+ * line: its numbers, separated by commas, semicolons or blanks, may
+ * follow the name of a kind. Empty lines and lines starting with '#'
+ * are skipped, and so is a first line of column names. Other files are
+ * raw native gint32 records: the parameters of a figure, or for
+ * splines the number of control points and their x, y pairs.
+ *
+ * Splines are given by their control points, conics by a, b and their
+ * zone. Every coordinate is at most IMPORT_MAX_COORDINATE.
+ */
+
+#define IMPORT_MAX_COORDINATE SCENE_MAX_COORDINATE
+
+#define IMPORT_ERROR (import_error_quark())
+
+typedef enum {
+	IMPORT_ERROR_FORMAT // a malformed record or a value out of range
+} ImportError;
+
+GQuark import_error_quark(void);
+
+/*
+ * The file is mapped and parsed in parallel chunks, then all the
+ * figures are added to scene in file order; nothing is added if any
+ * record is wrong. kind is used for records without a kind name. The
+ * ids of the new items are appended to ids, if it is not NULL.
+ */
+gboolean import_file(Scene *scene, const gchar *filename, SceneKind kind, GArray *ids, GError **error);
+
+G_END_DECLS
+
+#endif /* __IMPORT_H */
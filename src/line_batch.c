@@ -0,0 +1,445 @@
+#include "drawingpane_utils.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * Batch line rasterizers. Every SIMD lane steps its own line, with
+ * exactly the arithmetic of the scalar get_dda_line_figure and
+ * get_bresenham_line_figure, so the output is bit-identical to them.
+ * Lines are sorted by length so lanes of a group finish together.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+typedef struct _LineLane LineLane;
+struct _LineLane {
+	Pixel *pixels;
+	gint last; // index of the last pixel, -1 for an unused lane
+	gboolean reversed;
+
+	// DDA
+	gdouble x, y, dx, dy;
+
+	// Bresenham, along the major and the minor axis
+	gboolean is_y_major;
+	gint major, minor, inc, e, d_major, d_minor;
+};
+
+typedef void (*LineKernel)(LineLane **lanes, guint n);
+
+static LineLane unused_lane = {NULL, -1};
+
+static gint
+sign(gint x) {
+	return x < 0 ? -1 : (x > 0 ? 1 : 0);
+}
+
+static gint
+compare_lanes(gconstpointer a, gconstpointer b)
+{
+	const LineLane *lane_a = *(LineLane * const *) a;
+	const LineLane *lane_b = *(LineLane * const *) b;
+
+	return lane_b->last - lane_a->last;
+}
+
+static void
+init_dda_lane(LineLane *lane, const Segment *segment, GArray **figure)
+{
+	gint x1 = segment->x1, y1 = segment->y1, x2 = segment->x2, y2 = segment->y2;
+	gint length;
+
+	length = MAX(abs(x2 - x1), abs(y2 - y1));
+
+	*figure = figure_new(length + 1);
+	g_array_set_size(*figure, length + 1);
+
+	lane->pixels = &g_array_index(*figure, Pixel, 0);
+	lane->last = length;
+	lane->reversed = FALSE;
+
+	lane->x = x1;
+	lane->y = y1;
+	lane->dx = length > 0 ? (x2 - x1) / (gfloat)length : 0;
+	lane->dy = length > 0 ? (y2 - y1) / (gfloat)length : 0;
+}
+
+static void
+init_bresenham_lane(LineLane *lane, const Segment *segment, GArray **figure)
+{
+	gint x1 = segment->x1, y1 = segment->y1, x2 = segment->x2, y2 = segment->y2;
+	gint dx, dy;
+
+	dx = abs(x2 - x1);
+	dy = abs(y2 - y1);
+
+	lane->is_y_major = dx <= dy;
+
+	if (!lane->is_y_major) {
+		lane->reversed = x1 > x2;
+		lane->major = MIN(x1, x2);
+		lane->minor = lane->reversed ? y2 : y1;
+		lane->inc = lane->reversed ? sign(y1 - y2) : sign(y2 - y1);
+		lane->d_major = dx;
+		lane->d_minor = dy;
+	} else {
+		lane->reversed = y1 > y2;
+		lane->major = MIN(y1, y2);
+		lane->minor = lane->reversed ? x2 : x1;
+		lane->inc = lane->reversed ? sign(x1 - x2) : sign(x2 - x1);
+		lane->d_major = dy;
+		lane->d_minor = dx;
+	}
+
+	lane->e = lane->d_minor;
+	lane->last = lane->d_major;
+
+	*figure = figure_new(lane->last + 1);
+	g_array_set_size(*figure, lane->last + 1);
+	lane->pixels = &g_array_index(*figure, Pixel, 0);
+}
+
+static inline void
+set_pixel(LineLane *lane, gint i, gint x, gint y)
+{
+	Pixel *pixel;
+
+	pixel = &lane->pixels[lane->reversed ? lane->last - i : i];
+	pixel->x = x;
+	pixel->y = y;
+	pixel->alpha = 1;
+}
+
+static inline void
+set_bresenham_pixel(LineLane *lane, gint i, gint major, gint minor)
+{
+	if (lane->is_y_major) {
+		set_pixel(lane, i, minor, major);
+	} else {
+		set_pixel(lane, i, major, minor);
+	}
+}
+
+// Fills group with the next lanes lanes, padding it with unused_lane
+static void
+get_group(LineLane **lanes, guint n, guint start, guint lanes_count, LineLane **group)
+{
+	guint k;
+
+	for (k = 0; k < lanes_count; ++k) {
+		group[k] = start + k < n ? lanes[start + k] : &unused_lane;
+	}
+}
+
+static void
+dda_lines_scalar(LineLane **lanes, guint n)
+{
+	LineLane *lane;
+	gdouble x, y;
+	guint k;
+	gint i;
+
+	for (k = 0; k < n; ++k) {
+		lane = lanes[k];
+		x = lane->x;
+		y = lane->y;
+
+		for (i = 0; i <= lane->last; ++i) {
+			set_pixel(lane, i, round(x), round(y));
+			x += lane->dx;
+			y += lane->dy;
+		}
+	}
+}
+
+static void
+bresenham_lines_scalar(LineLane **lanes, guint n)
+{
+	LineLane *lane;
+	gint major, minor, e;
+	guint k;
+	gint i;
+
+	for (k = 0; k < n; ++k) {
+		lane = lanes[k];
+		major = lane->major;
+		minor = lane->minor;
+		e = lane->e;
+
+		for (i = 0; i <= lane->last; ++i, ++major) {
+			set_bresenham_pixel(lane, i, major, minor);
+
+			if (2 * e >= lane->d_major) {
+				minor += lane->inc;
+				e -= lane->d_major;
+			}
+
+			e += lane->d_minor;
+		}
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// round(), i.e. halfway cases away from zero, for values in gint range
+__attribute__((target("sse2")))
+static inline __m128i
+round_pd_sse2(__m128d x)
+{
+	const __m128d half = _mm_set1_pd(0.5), one = _mm_set1_pd(1);
+	__m128d t, f, up, down;
+
+	t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+	f = _mm_sub_pd(x, t);
+	up = _mm_and_pd(_mm_cmpge_pd(f, half), one);
+	down = _mm_and_pd(_mm_cmple_pd(f, _mm_sub_pd(_mm_setzero_pd(), half)), one);
+
+	return _mm_cvttpd_epi32(_mm_add_pd(t, _mm_sub_pd(up, down)));
+}
+
+__attribute__((target("sse2")))
+static void
+dda_lines_sse2(LineLane **lanes, guint n)
+{
+	LineLane *group[2];
+	gint x[4], y[4];
+	__m128d vx, vy, vdx, vdy;
+	guint g, k;
+	gint i;
+
+	for (g = 0; g < n; g += 2) {
+		get_group(lanes, n, g, 2, group);
+
+		vx = _mm_set_pd(group[1]->x, group[0]->x);
+		vy = _mm_set_pd(group[1]->y, group[0]->y);
+		vdx = _mm_set_pd(group[1]->dx, group[0]->dx);
+		vdy = _mm_set_pd(group[1]->dy, group[0]->dy);
+
+		for (i = 0; i <= group[0]->last; ++i) {
+			_mm_storeu_si128((__m128i *) x, round_pd_sse2(vx));
+			_mm_storeu_si128((__m128i *) y, round_pd_sse2(vy));
+
+			for (k = 0; k < 2; ++k) {
+				if (i <= group[k]->last) {
+					set_pixel(group[k], i, x[k], y[k]);
+				}
+			}
+
+			vx = _mm_add_pd(vx, vdx);
+			vy = _mm_add_pd(vy, vdy);
+		}
+	}
+}
+
+__attribute__((target("sse2")))
+static void
+bresenham_lines_sse2(LineLane **lanes, guint n)
+{
+	LineLane *group[4];
+	gint major[4], minor[4];
+	__m128i vmajor, vminor, ve, vinc, vd_major, vd_major_1, vd_minor, mask;
+	const __m128i one = _mm_set1_epi32(1);
+	guint g, k;
+	gint i;
+
+	for (g = 0; g < n; g += 4) {
+		get_group(lanes, n, g, 4, group);
+
+#define LANES_SSE2(field) _mm_set_epi32(group[3]->field, group[2]->field, group[1]->field, group[0]->field)
+		vmajor = LANES_SSE2(major);
+		vminor = LANES_SSE2(minor);
+		ve = LANES_SSE2(e);
+		vinc = LANES_SSE2(inc);
+		vd_major = LANES_SSE2(d_major);
+		vd_minor = LANES_SSE2(d_minor);
+#undef LANES_SSE2
+		vd_major_1 = _mm_sub_epi32(vd_major, one);
+
+		for (i = 0; i <= group[0]->last; ++i) {
+			_mm_storeu_si128((__m128i *) major, vmajor);
+			_mm_storeu_si128((__m128i *) minor, vminor);
+
+			for (k = 0; k < 4; ++k) {
+				if (i <= group[k]->last) {
+					set_bresenham_pixel(group[k], i, major[k], minor[k]);
+				}
+			}
+
+			// 2 * e >= d_major
+			mask = _mm_cmpgt_epi32(_mm_add_epi32(ve, ve), vd_major_1);
+			vminor = _mm_add_epi32(vminor, _mm_and_si128(mask, vinc));
+			ve = _mm_add_epi32(_mm_sub_epi32(ve, _mm_and_si128(mask, vd_major)), vd_minor);
+			vmajor = _mm_add_epi32(vmajor, one);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m128i
+round_pd_avx2(__m256d x)
+{
+	const __m256d half = _mm256_set1_pd(0.5), one = _mm256_set1_pd(1);
+	__m256d t, f, up, down;
+
+	t = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(x));
+	f = _mm256_sub_pd(x, t);
+	up = _mm256_and_pd(_mm256_cmp_pd(f, half, _CMP_GE_OQ), one);
+	down = _mm256_and_pd(_mm256_cmp_pd(f, _mm256_sub_pd(_mm256_setzero_pd(), half), _CMP_LE_OQ), one);
+
+	return _mm256_cvttpd_epi32(_mm256_add_pd(t, _mm256_sub_pd(up, down)));
+}
+
+__attribute__((target("avx2")))
+static void
+dda_lines_avx2(LineLane **lanes, guint n)
+{
+	LineLane *group[4];
+	gint x[4], y[4];
+	__m256d vx, vy, vdx, vdy;
+	guint g, k;
+	gint i;
+
+	for (g = 0; g < n; g += 4) {
+		get_group(lanes, n, g, 4, group);
+
+#define LANES_AVX2(field) _mm256_set_pd(group[3]->field, group[2]->field, group[1]->field, group[0]->field)
+		vx = LANES_AVX2(x);
+		vy = LANES_AVX2(y);
+		vdx = LANES_AVX2(dx);
+		vdy = LANES_AVX2(dy);
+#undef LANES_AVX2
+
+		for (i = 0; i <= group[0]->last; ++i) {
+			_mm_storeu_si128((__m128i *) x, round_pd_avx2(vx));
+			_mm_storeu_si128((__m128i *) y, round_pd_avx2(vy));
+
+			for (k = 0; k < 4; ++k) {
+				if (i <= group[k]->last) {
+					set_pixel(group[k], i, x[k], y[k]);
+				}
+			}
+
+			vx = _mm256_add_pd(vx, vdx);
+			vy = _mm256_add_pd(vy, vdy);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void
+bresenham_lines_avx2(LineLane **lanes, guint n)
+{
+	LineLane *group[8];
+	gint major[8], minor[8];
+	__m256i vmajor, vminor, ve, vinc, vd_major, vd_major_1, vd_minor, mask;
+	const __m256i one = _mm256_set1_epi32(1);
+	guint g, k;
+	gint i;
+
+	for (g = 0; g < n; g += 8) {
+		get_group(lanes, n, g, 8, group);
+
+#define LANES_AVX2(field) _mm256_set_epi32(group[7]->field, group[6]->field, group[5]->field, \
+		group[4]->field, group[3]->field, group[2]->field, group[1]->field, group[0]->field)
+		vmajor = LANES_AVX2(major);
+		vminor = LANES_AVX2(minor);
+		ve = LANES_AVX2(e);
+		vinc = LANES_AVX2(inc);
+		vd_major = LANES_AVX2(d_major);
+		vd_minor = LANES_AVX2(d_minor);
+#undef LANES_AVX2
+		vd_major_1 = _mm256_sub_epi32(vd_major, one);
+
+		for (i = 0; i <= group[0]->last; ++i) {
+			_mm256_storeu_si256((__m256i *) major, vmajor);
+			_mm256_storeu_si256((__m256i *) minor, vminor);
+
+			for (k = 0; k < 8; ++k) {
+				if (i <= group[k]->last) {
+					set_bresenham_pixel(group[k], i, major[k], minor[k]);
+				}
+			}
+
+			// 2 * e >= d_major
+			mask = _mm256_cmpgt_epi32(_mm256_add_epi32(ve, ve), vd_major_1);
+			vminor = _mm256_add_epi32(vminor, _mm256_and_si256(mask, vinc));
+			ve = _mm256_add_epi32(_mm256_sub_epi32(ve, _mm256_and_si256(mask, vd_major)), vd_minor);
+			vmajor = _mm256_add_epi32(vmajor, one);
+		}
+	}
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+static LineKernel
+get_dda_kernel(void)
+{
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return dda_lines_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return dda_lines_sse2;
+	}
+#endif
+	return dda_lines_scalar;
+}
+
+static LineKernel
+get_bresenham_kernel(void)
+{
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return bresenham_lines_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return bresenham_lines_sse2;
+	}
+#endif
+	return bresenham_lines_scalar;
+}
+
+static void
+rasterize_lines(const Segment *segments, guint n, GArray **figures,
+		void (*init_lane)(LineLane *, const Segment *, GArray **), LineKernel kernel)
+{
+	LineLane *lanes;
+	LineLane **sorted;
+	guint i;
+
+	if (n == 0) {
+		return;
+	}
+
+	lanes = g_new(LineLane, n);
+	sorted = g_new(LineLane *, n);
+
+	for (i = 0; i < n; ++i) {
+		init_lane(&lanes[i], &segments[i], &figures[i]);
+		sorted[i] = &lanes[i];
+	}
+
+	qsort(sorted, n, sizeof(LineLane *), compare_lanes);
+	kernel(sorted, n);
+
+	g_free(sorted);
+	g_free(lanes);
+}
+
+void
+get_dda_line_figures(const Segment *segments, guint n, GArray **figures)
+{
+	rasterize_lines(segments, n, figures, init_dda_lane, get_dda_kernel());
+}
+
+void
+get_bresenham_line_figures(const Segment *segments, guint n, GArray **figures)
+{
+	rasterize_lines(segments, n, figures, init_bresenham_lane, get_bresenham_kernel());
+}
@@ -1,5 +1,6 @@
 #include <gtk/gtk.h>
 
+#include "batch_render.h"
 #include "graphicseditor.h"
 
 int
@@ -8,6 +9,11 @@ main (int argc, char *argv[])
 	GraphicsEditor *app;
 	int status;
 
+	// Rendering from the command line needs no display
+	if (batch_render_requested(argc, argv)) {
+		return batch_render_main(argc, argv);
+	}
+
 	app = graphicseditor_new();
 	status = g_application_run (G_APPLICATION (app), argc, argv);
 	g_object_unref(app);
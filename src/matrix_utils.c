@@ -11,6 +11,17 @@ void multiplication_mat4_vec4(vec4 result, mat4 m, vec4 v) {
     }
 }
 
+void multiplication_vec4_mat4(vec4 result, vec4 v, mat4 m) {
+    int i, j;
+
+    for (j = 0; j < 4; ++j) {
+        result[j] = 0;
+        for (i = 0; i < 4; ++i) {
+            result[j] += v[i] * m[i][j];
+        }
+    }
+}
+
 void multiplication_vec4_vec4(double *result, vec4 v1, vec4 v2) {
     int i;
     *result = 0;
@@ -10,6 +10,7 @@ typedef gdouble mat4[4][4];
 typedef gdouble vec4[4];
 
 void multiplication_mat4_vec4(vec4 result, mat4 m, vec4 v);
+void multiplication_vec4_mat4(vec4 result, vec4 v, mat4 m);
 void multiplication_vec4_vec4(double *result, vec4 v1, vec4 v2);
 
 G_END_DECLS
@@ -0,0 +1,311 @@
+#include "png_export.h"
+#include "spatial_grid.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#define EXPORT_GRID_CELL_SIZE 64
+#define EXPORT_BAND_SIZE (16 << 20) // bytes of zoomed rows per band
+#define EXPORT_CHUNK_SIZE (64 << 10) // bytes of compressed data per IDAT
+#define EXPORT_PIXELS_BUDGET (64 << 20) // bytes of pixels kept for later bands
+
+typedef struct _PngWriter PngWriter;
+struct _PngWriter {
+	FILE *file;
+	z_stream stream;
+	guchar chunk[EXPORT_CHUNK_SIZE];
+	gint error_code; // errno of the first failed write, 0 if none
+};
+
+typedef struct _KeptPixels KeptPixels;
+struct _KeptPixels {
+	GArray *pixels; // sorted by y, the ones not drawn yet
+	gsize size; // bytes allocated for the pixels
+};
+
+typedef struct _BandData BandData;
+struct _BandData {
+	guchar *data;
+	gint stride;
+	gint origin_x, origin_y;
+	gint width, height;
+	Bounds bounds; // canvas cells of the band
+	GHashTable *pixels; // Figure -> KeptPixels for later bands
+	gsize pixels_size; // bytes allocated for all the kept pixels
+};
+
+static void index_item(guint id, SceneItem *item, gpointer user_data);
+static void set_failed(PngWriter *writer);
+static void write_chunk(PngWriter *writer, const gchar *type, const guchar *data, gsize size);
+static void write_pixels(PngWriter *writer, const guchar *data, gsize size, gint flush);
+static gint compare_pixel_y(gconstpointer a, gconstpointer b);
+static void kept_pixels_free(KeptPixels *kept);
+static void draw_band_figure(gpointer item, const Bounds *bounds, gpointer user_data);
+
+static void
+index_item(guint id, SceneItem *item, gpointer user_data)
+{
+	Figure *figure;
+	guint i;
+
+	for (i = 0; i < item->segments->len; ++i) {
+		figure = g_ptr_array_index(item->segments, i);
+		if (!figure->is_empty) {
+			spatial_grid_insert(user_data, figure, &figure->bounds);
+		}
+	}
+}
+
+static void
+set_failed(PngWriter *writer)
+{
+	if (writer->error_code == 0) {
+		writer->error_code = errno != 0 ? errno : EIO;
+	}
+}
+
+static void
+write_chunk(PngWriter *writer, const gchar *type, const guchar *data, gsize size)
+{
+	guint32 length, crc;
+
+	length = GUINT32_TO_BE(size);
+	// crc32() restarts on a NULL buffer
+	crc = crc32(0, (const Bytef *) type, 4);
+	if (size > 0) {
+		crc = crc32(crc, data, size);
+	}
+	crc = GUINT32_TO_BE(crc);
+
+	if (fwrite(&length, 4, 1, writer->file) != 1
+			|| fwrite(type, 4, 1, writer->file) != 1
+			|| (size > 0 && fwrite(data, size, 1, writer->file) != 1)
+			|| fwrite(&crc, 4, 1, writer->file) != 1) {
+		set_failed(writer);
+	}
+}
+
+// Compresses data into IDAT chunks, which are written as they fill up
+static void
+write_pixels(PngWriter *writer, const guchar *data, gsize size, gint flush)
+{
+	writer->stream.next_in = (Bytef *) data;
+	writer->stream.avail_in = size;
+
+	do {
+		writer->stream.next_out = writer->chunk;
+		writer->stream.avail_out = EXPORT_CHUNK_SIZE;
+		deflate(&writer->stream, flush);
+
+		if (writer->stream.avail_out < EXPORT_CHUNK_SIZE) {
+			write_chunk(writer, "IDAT", writer->chunk, EXPORT_CHUNK_SIZE - writer->stream.avail_out);
+		}
+	} while (writer->stream.avail_out == 0);
+}
+
+static gint
+compare_pixel_y(gconstpointer a, gconstpointer b)
+{
+	const Pixel *pixel_a = a;
+	const Pixel *pixel_b = b;
+
+	return (pixel_a->y > pixel_b->y) - (pixel_a->y < pixel_b->y);
+}
+
+static void
+kept_pixels_free(KeptPixels *kept)
+{
+	figure_free(kept->pixels);
+	g_free(kept);
+}
+
+/*
+ * Conics are rasterized inside the band only. Other figures that reach
+ * later bands keep their pixels, sorted by y, while the pixels not
+ * drawn yet fit EXPORT_PIXELS_BUDGET; every band draws and drops the
+ * pixels at the end. The rest are rasterized again for every band.
+ */
+static void
+draw_band_figure(gpointer item, const Bounds *bounds, gpointer user_data)
+{
+	Figure *figure = item;
+	BandData *band = user_data;
+	const SceneKindInfo *info;
+	KeptPixels *kept;
+	GArray *pixels;
+	guint k;
+
+	info = &scene_kinds[figure->kind];
+	kept = g_hash_table_lookup(band->pixels, figure);
+
+	if (kept == NULL) {
+		if (info->rasterize_clipped != NULL) {
+			pixels = info->rasterize_clipped(figure->params, &band->bounds);
+		} else {
+			pixels = info->rasterize(figure->params);
+		}
+
+		if (info->rasterize_clipped != NULL || figure->bounds.y1 >= band->bounds.y1
+				|| band->pixels_size + pixels->len * sizeof(Pixel) > EXPORT_PIXELS_BUDGET) {
+			draw_figure_on_buffer(pixels, band->data, band->stride, band->origin_x, band->origin_y,
+					0, 0, band->width, band->height);
+			figure_free(pixels);
+			return;
+		}
+
+		// A stable sort keeps the order in which a cell is blended
+		g_array_sort(pixels, compare_pixel_y);
+
+		kept = g_malloc(sizeof(KeptPixels));
+		kept->pixels = pixels;
+		kept->size = pixels->len * sizeof(Pixel);
+		g_hash_table_insert(band->pixels, figure, kept);
+		band->pixels_size += kept->size;
+	}
+
+	pixels = kept->pixels;
+	for (k = pixels->len; k > 0 && g_array_index(pixels, Pixel, k - 1).y >= band->bounds.y1; --k);
+
+	draw_pixels_on_buffer(&g_array_index(pixels, Pixel, k), pixels->len - k,
+			band->data, band->stride, band->origin_x, band->origin_y,
+			0, 0, band->width, band->height);
+
+	// Shrinking does not give memory back, so the pixels stay charged
+	// until the figure is done
+	g_array_set_size(pixels, k);
+
+	if (k == 0) {
+		band->pixels_size -= kept->size;
+		g_hash_table_remove(band->pixels, figure);
+	}
+}
+
+gboolean
+png_export(Scene *scene, gint width, gint height, gint cell_size,
+		const gchar *filename, GError **error)
+{
+	static const guchar signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	PngWriter *writer;
+	SpatialGrid *grid;
+	BandData band;
+	guchar header[13];
+	guchar *zoomed, *row;
+	const guint32 *zoomed_row;
+	guint32 image_width, image_height, value;
+	gint band_cells, row_cells, y, i, j;
+	gint error_code;
+
+	g_return_val_if_fail(width > 0 && height > 0 && cell_size > 0, FALSE);
+
+	// One row of cells zoomed must fit a band buffer
+	if ((gint64) width * cell_size * cell_size > G_MAXINT / 4 || (gint64) height * cell_size > G_MAXINT) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+				"The image is too large to export at this zoom");
+		return FALSE;
+	}
+
+	image_width = width * cell_size;
+	image_height = height * cell_size;
+
+	writer = g_malloc(sizeof(PngWriter));
+	writer->error_code = 0;
+	writer->file = g_fopen(filename, "wb");
+	if (writer->file == NULL) {
+		error_code = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(error_code),
+				"Failed to create %s: %s", filename, g_strerror(error_code));
+		g_free(writer);
+		return FALSE;
+	}
+
+	memset(&writer->stream, 0, sizeof(z_stream));
+	deflateInit(&writer->stream, Z_DEFAULT_COMPRESSION);
+
+	// 8 bit RGB, not interlaced
+	value = GUINT32_TO_BE(image_width);
+	memcpy(header, &value, 4);
+	value = GUINT32_TO_BE(image_height);
+	memcpy(header + 4, &value, 4);
+	header[8] = 8;
+	header[9] = 2;
+	header[10] = header[11] = header[12] = 0;
+
+	if (fwrite(signature, sizeof(signature), 1, writer->file) != 1) {
+		set_failed(writer);
+	}
+	write_chunk(writer, "IHDR", header, sizeof(header));
+
+	grid = spatial_grid_new(EXPORT_GRID_CELL_SIZE);
+	scene_foreach(scene, SCENE_KIND_NONE, index_item, grid);
+
+	// A band is as many canvas rows as fit EXPORT_BAND_SIZE once zoomed
+	row_cells = MAX(1, EXPORT_BAND_SIZE / ((gint64) image_width * 4 * cell_size));
+	row_cells = MIN(row_cells, height);
+
+	band.stride = width * 4;
+	band.data = g_malloc(band.stride * row_cells);
+	band.origin_x = width / 2;
+	band.width = width;
+	band.pixels = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) kept_pixels_free);
+	band.pixels_size = 0;
+
+	zoomed = g_malloc((gsize) image_width * 4 * cell_size * row_cells);
+	row = g_malloc(1 + image_width * 3);
+	row[0] = 0; // no filter
+
+	for (y = 0; y < height && writer->error_code == 0; y += band_cells) {
+		band_cells = MIN(row_cells, height - y);
+
+		band.origin_y = height / 2 - y;
+		band.height = band_cells;
+		band.bounds.x1 = - band.origin_x;
+		band.bounds.x2 = band.bounds.x1 + width - 1;
+		band.bounds.y2 = band.origin_y;
+		band.bounds.y1 = band.origin_y - band_cells + 1;
+		memset(band.data, 0, band.stride * band_cells);
+
+		spatial_grid_query(grid, &band.bounds, draw_band_figure, &band);
+
+		draw_zoomed_buffer(band.data, band.stride, width, band_cells,
+				zoomed, image_width * 4, 0, 0, image_width, band_cells * cell_size,
+				cell_size, 0);
+
+		for (j = 0; j < band_cells * cell_size; ++j) {
+			zoomed_row = (const guint32 *) (zoomed + (gsize) j * image_width * 4);
+			for (i = 0; i < (gint) image_width; ++i) {
+				row[1 + 3 * i] = zoomed_row[i] >> 16;
+				row[2 + 3 * i] = zoomed_row[i] >> 8;
+				row[3 + 3 * i] = zoomed_row[i];
+			}
+			write_pixels(writer, row, 1 + image_width * 3, Z_NO_FLUSH);
+		}
+	}
+
+	write_pixels(writer, NULL, 0, Z_FINISH);
+	write_chunk(writer, "IEND", NULL, 0);
+	deflateEnd(&writer->stream);
+
+	g_free(row);
+	g_free(zoomed);
+	g_free(band.data);
+	g_hash_table_unref(band.pixels);
+	spatial_grid_free(grid);
+
+	if (fclose(writer->file) != 0) {
+		set_failed(writer);
+	}
+
+	error_code = writer->error_code;
+	g_free(writer);
+
+	if (error_code != 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(error_code),
+				"Failed to write %s: %s", filename, g_strerror(error_code));
+		g_unlink(filename);
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,19 @@
+#ifndef __PNG_EXPORT_H
+#define __PNG_EXPORT_H
+
+#include "scene.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Writes the figures of scene on a width x height canvas as an RGB
+ * PNG image, every cell cell_size pixels wide, on a white background.
+ * The image is rasterized and compressed in bands of rows, so memory
+ * use is bounded by one band whatever the size of the image.
+ */
+gboolean png_export(Scene *scene, gint width, gint height, gint cell_size,
+		const gchar *filename, GError **error);
+
+G_END_DECLS
+
+#endif /* __PNG_EXPORT_H */
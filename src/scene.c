@@ -0,0 +1,514 @@
+#include "scene.h"
+#include <string.h>
+
+struct _Scene {
+	GArray *items; // SceneItem, the item with id i is at i - 1
+	guint first_free; // id of the first free slot, 0 if none
+};
+
+static GArray *rasterize_dda_line(const gint *params);
+static GArray *rasterize_bresenham_line(const gint *params);
+static GArray *rasterize_wu_line(const gint *params);
+static GArray *rasterize_ellipse(const gint *params);
+static GArray *rasterize_hyperbole(const gint *params);
+static GArray *rasterize_ellipse_clipped(const gint *params, const Bounds *clip);
+static GArray *rasterize_hyperbole_clipped(const gint *params, const Bounds *clip);
+static gboolean clip_zone(const gint *params, const Bounds *clip, gint *zone);
+static GArray *rasterize_bezier(const gint *params);
+static GArray *rasterize_hermitian(const gint *params);
+static GArray *rasterize_b_spline(const gint *params);
+static gboolean get_line_bounds(const gint *params, Bounds *bounds);
+static gboolean get_wu_line_bounds(const gint *params, Bounds *bounds);
+static gboolean get_zone_bounds(const gint *params, Bounds *bounds);
+static gboolean get_ellipse_bounds(const gint *params, Bounds *bounds);
+static gboolean get_hyperbole_bounds(const gint *params, Bounds *bounds);
+static gboolean get_bezier_bounds(const gint *params, Bounds *bounds);
+static gboolean get_hermitian_bounds(const gint *params, Bounds *bounds);
+static gboolean get_b_spline_bounds(const gint *params, Bounds *bounds);
+static guint get_single_segment_count(guint n_points);
+static guint get_b_spline_segment_count(guint n_points);
+static void fill_segment_params(GList *link, gint j, gint n, gint *params);
+static void clear_item(SceneItem *item);
+
+const SceneKindInfo scene_kinds[SCENE_N_KINDS] = {
+	[SCENE_KIND_NONE] = {"none", 0, NULL, NULL, NULL, NULL},
+	[SCENE_KIND_DDA_LINE] = {"dda", 4, rasterize_dda_line, NULL, get_line_bounds, NULL},
+	[SCENE_KIND_BRESENHAM_LINE] = {"bresenham", 4, rasterize_bresenham_line, NULL, get_line_bounds, NULL},
+	[SCENE_KIND_WU_LINE] = {"wu", 4, rasterize_wu_line, NULL, get_wu_line_bounds, NULL},
+	[SCENE_KIND_ELLIPSE] = {"ellipse", 6, rasterize_ellipse, rasterize_ellipse_clipped,
+			get_ellipse_bounds, NULL},
+	[SCENE_KIND_HYPERBOLE] = {"hyperbole", 6, rasterize_hyperbole, rasterize_hyperbole_clipped,
+			get_hyperbole_bounds, NULL},
+	[SCENE_KIND_BEZIER] = {"bezier", 8, rasterize_bezier, NULL,
+			get_bezier_bounds, get_single_segment_count},
+	[SCENE_KIND_HERMITIAN] = {"hermit", 8, rasterize_hermitian, NULL,
+			get_hermitian_bounds, get_single_segment_count},
+	[SCENE_KIND_B_SPLINE] = {"b-spline", 8, rasterize_b_spline, NULL,
+			get_b_spline_bounds, get_b_spline_segment_count}
+};
+
+static GArray *
+rasterize_dda_line(const gint *params)
+{
+	return get_dda_line_figure(params[0], params[1], params[2], params[3]);
+}
+
+static GArray *
+rasterize_bresenham_line(const gint *params)
+{
+	return get_bresenham_line_figure(params[0], params[1], params[2], params[3]);
+}
+
+static GArray *
+rasterize_wu_line(const gint *params)
+{
+	return get_wu_line_figure(params[0], params[1], params[2], params[3]);
+}
+
+static GArray *
+rasterize_ellipse(const gint *params)
+{
+	return get_ellipse_figure(params[0], params[1], params[2], params[3], params[4], params[5]);
+}
+
+static GArray *
+rasterize_hyperbole(const gint *params)
+{
+	return get_hyperbole_figure(params[0], params[1], params[2], params[3], params[4], params[5]);
+}
+
+// Zone of a conic cut down to clip, FALSE if nothing is left
+static gboolean
+clip_zone(const gint *params, const Bounds *clip, gint *zone)
+{
+	Bounds bounds;
+
+	if (!get_zone_bounds(params, &bounds) || !bounds_intersect(&bounds, clip)) {
+		return FALSE;
+	}
+
+	zone[0] = MAX(bounds.x1, clip->x1);
+	zone[1] = MAX(bounds.y1, clip->y1);
+	zone[2] = MIN(bounds.x2, clip->x2) - zone[0];
+	zone[3] = MIN(bounds.y2, clip->y2) - zone[1];
+
+	return TRUE;
+}
+
+// The conics generate only the pixels inside their zone
+static GArray *
+rasterize_ellipse_clipped(const gint *params, const Bounds *clip)
+{
+	gint zone[4];
+
+	if (!clip_zone(params, clip, zone)) {
+		return figure_new(0);
+	}
+
+	return get_ellipse_figure(params[0], params[1], zone[0], zone[1], zone[2], zone[3]);
+}
+
+static GArray *
+rasterize_hyperbole_clipped(const gint *params, const Bounds *clip)
+{
+	gint zone[4];
+
+	if (!clip_zone(params, clip, zone)) {
+		return figure_new(0);
+	}
+
+	return get_hyperbole_figure(params[0], params[1], zone[0], zone[1], zone[2], zone[3]);
+}
+
+static GArray *
+rasterize_bezier(const gint *params)
+{
+	return get_cubic_figure(CUBIC_BEZIER, params);
+}
+
+static GArray *
+rasterize_hermitian(const gint *params)
+{
+	return get_cubic_figure(CUBIC_HERMITIAN, params);
+}
+
+static GArray *
+rasterize_b_spline(const gint *params)
+{
+	return get_cubic_figure(CUBIC_B_SPLINE, params);
+}
+
+static gboolean
+get_line_bounds(const gint *params, Bounds *bounds)
+{
+	bounds->x1 = MIN(params[0], params[2]);
+	bounds->y1 = MIN(params[1], params[3]);
+	bounds->x2 = MAX(params[0], params[2]);
+	bounds->y2 = MAX(params[1], params[3]);
+
+	return TRUE;
+}
+
+// Wu lines also shade the pixels next to the ideal line
+static gboolean
+get_wu_line_bounds(const gint *params, Bounds *bounds)
+{
+	get_line_bounds(params, bounds);
+
+	bounds->x1 -= 1;
+	bounds->y1 -= 1;
+	bounds->x2 += 1;
+	bounds->y2 += 1;
+
+	return TRUE;
+}
+
+// Zone of a conic, which may be given with a negative width or height
+static gboolean
+get_zone_bounds(const gint *params, Bounds *bounds)
+{
+	gint64 x2, y2;
+
+	if (params[0] < 1 || params[1] < 1) {
+		return FALSE;
+	}
+
+	x2 = (gint64) params[2] + params[4];
+	y2 = (gint64) params[3] + params[5];
+
+	bounds->x1 = CLAMP(MIN(params[2], x2), G_MININT, G_MAXINT);
+	bounds->y1 = CLAMP(MIN(params[3], y2), G_MININT, G_MAXINT);
+	bounds->x2 = CLAMP(MAX(params[2], x2), G_MININT, G_MAXINT);
+	bounds->y2 = CLAMP(MAX(params[3], y2), G_MININT, G_MAXINT);
+
+	return TRUE;
+}
+
+static gboolean
+get_ellipse_bounds(const gint *params, Bounds *bounds)
+{
+	Bounds axes = {- params[0], - params[1], params[0], params[1]};
+
+	if (!get_zone_bounds(params, bounds) || !bounds_intersect(bounds, &axes)) {
+		return FALSE;
+	}
+
+	bounds->x1 = MAX(bounds->x1, axes.x1);
+	bounds->y1 = MAX(bounds->y1, axes.y1);
+	bounds->x2 = MIN(bounds->x2, axes.x2);
+	bounds->y2 = MIN(bounds->y2, axes.y2);
+
+	return TRUE;
+}
+
+static gboolean
+get_hyperbole_bounds(const gint *params, Bounds *bounds)
+{
+	if (!get_zone_bounds(params, bounds)) {
+		return FALSE;
+	}
+
+	bounds->x1 = CLAMP(bounds->x1, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	bounds->y1 = CLAMP(bounds->y1, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	bounds->x2 = CLAMP(bounds->x2, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+	bounds->y2 = CLAMP(bounds->y2, - HYPERBOLE_MAX_COORDINATE, HYPERBOLE_MAX_COORDINATE);
+
+	return TRUE;
+}
+
+static gboolean
+get_bezier_bounds(const gint *params, Bounds *bounds)
+{
+	get_cubic_bounds(CUBIC_BEZIER, params, bounds);
+
+	return TRUE;
+}
+
+static gboolean
+get_hermitian_bounds(const gint *params, Bounds *bounds)
+{
+	get_cubic_bounds(CUBIC_HERMITIAN, params, bounds);
+
+	return TRUE;
+}
+
+static gboolean
+get_b_spline_bounds(const gint *params, Bounds *bounds)
+{
+	get_cubic_bounds(CUBIC_B_SPLINE, params, bounds);
+
+	return TRUE;
+}
+
+// Bezier and Hermitian forms are a single segment
+static guint
+get_single_segment_count(guint n_points)
+{
+	return 1;
+}
+
+static guint
+get_b_spline_segment_count(guint n_points)
+{
+	return n_points + 1;
+}
+
+SceneKind
+scene_kind_from_name(const gchar *name, gsize length)
+{
+	SceneKind kind;
+
+	for (kind = SCENE_KIND_NONE + 1; kind < SCENE_N_KINDS; ++kind) {
+		if (strlen(scene_kinds[kind].name) == length
+				&& g_ascii_strncasecmp(scene_kinds[kind].name, name, length) == 0) {
+			return kind;
+		}
+	}
+
+	return SCENE_KIND_NONE;
+}
+
+const gchar *
+scene_check_values(SceneKind kind, const gint *values, guint n)
+{
+	guint i;
+
+	for (i = 0; i < n; ++i) {
+		if (values[i] < - SCENE_MAX_COORDINATE || values[i] > SCENE_MAX_COORDINATE) {
+			return "a value is out of range";
+		}
+	}
+
+	if (scene_kinds[kind].get_segment_count == NULL) {
+		if (n != (guint) scene_kinds[kind].n_params) {
+			return "wrong number of values";
+		}
+	} else if (n == 0 || n % 2 != 0 || (kind != SCENE_KIND_B_SPLINE && n != 8)) {
+		return "wrong number of control points";
+	}
+
+	if ((kind == SCENE_KIND_ELLIPSE && (values[0] <= 0 || values[0] > ELLIPSE_MAX_AXIS
+			|| values[1] <= 0 || values[1] > ELLIPSE_MAX_AXIS))
+			|| (kind == SCENE_KIND_HYPERBOLE && (values[0] <= 0 || values[0] > HYPERBOLE_MAX_AXIS
+			|| values[1] <= 0 || values[1] > HYPERBOLE_MAX_AXIS))) {
+		return "an axis is out of range";
+	}
+
+	return NULL;
+}
+
+Figure *
+scene_figure_new(SceneKind kind, const gint *params)
+{
+	Figure *figure;
+
+	g_return_val_if_fail(kind > SCENE_KIND_NONE && kind < SCENE_N_KINDS, NULL);
+
+	figure = g_malloc0(sizeof(Figure));
+	figure->kind = kind;
+	memcpy(figure->params, params, scene_kinds[kind].n_params * sizeof(gint));
+	figure->pixels = NULL;
+	figure->is_empty = !scene_kinds[kind].get_bounds(figure->params, &figure->bounds);
+
+	return figure;
+}
+
+void
+scene_figure_free(Figure *figure)
+{
+	if (figure->pixels != NULL) {
+		figure_free(figure->pixels);
+	}
+	g_free(figure);
+}
+
+GArray *
+scene_figure_get_pixels(Figure *figure)
+{
+	if (figure->pixels == NULL) {
+		figure->pixels = scene_kinds[figure->kind].rasterize(figure->params);
+	}
+
+	return figure->pixels;
+}
+
+// Reads the four control points from link on, where link holds the
+// point with index j; B-spline indexes outside [0, n) repeat the ends
+static void
+fill_segment_params(GList *link, gint j, gint n, gint *params)
+{
+	Point *point;
+	gint i;
+
+	for (i = 0; i < 4; ++i, ++j) {
+		if (i > 0 && j > 0 && j < n) {
+			link = g_list_next(link);
+		}
+		point = link->data;
+
+		params[2 * i] = point->x;
+		params[2 * i + 1] = point->y;
+	}
+}
+
+void
+scene_get_segment_params(SceneItem *item, guint index, gint *params)
+{
+	gint n, j;
+
+	n = g_list_length(item->points);
+	j = item->kind == SCENE_KIND_B_SPLINE ? (gint) index - 2 : 0;
+
+	fill_segment_params(g_list_nth(item->points, CLAMP(j, 0, n - 1)), j, n, params);
+}
+
+guint
+scene_add_spline(Scene *scene, SceneKind kind, GList *points)
+{
+	SceneItem *item;
+	GList *link;
+	gint params[SCENE_MAX_PARAMS];
+	guint id, n_segments, i;
+	gint n, j;
+
+	g_return_val_if_fail(scene_kinds[kind].get_segment_count != NULL, 0);
+
+	id = scene_add(scene, kind, points);
+	item = scene_get(scene, id);
+
+	n = g_list_length(points);
+	n_segments = scene_kinds[kind].get_segment_count(n);
+
+	// Walks the points once, unlike scene_get_segment_params
+	link = points;
+	j = kind == SCENE_KIND_B_SPLINE ? -2 : 0;
+	for (i = 0; i < n_segments; ++i, ++j) {
+		if (j > 0 && j < n) {
+			link = g_list_next(link);
+		}
+		fill_segment_params(link, j, n, params);
+		g_ptr_array_add(item->segments, scene_figure_new(kind, params));
+	}
+
+	return id;
+}
+
+guint
+scene_add_figure(Scene *scene, SceneKind kind, const gint *params)
+{
+	guint id;
+
+	g_return_val_if_fail(scene_kinds[kind].get_segment_count == NULL, 0);
+
+	id = scene_add(scene, kind, NULL);
+	g_ptr_array_add(scene_get(scene, id)->segments, scene_figure_new(kind, params));
+
+	return id;
+}
+
+static void
+clear_item(SceneItem *item)
+{
+	guint i;
+
+	for (i = 0; i < item->segments->len; ++i) {
+		scene_figure_free(g_ptr_array_index(item->segments, i));
+	}
+	g_ptr_array_free(item->segments, TRUE);
+	item->segments = NULL;
+
+	g_list_free_full(item->points, g_free);
+	item->points = NULL;
+
+	item->kind = SCENE_KIND_NONE;
+}
+
+Scene *
+scene_new(void)
+{
+	Scene *scene;
+
+	scene = g_malloc(sizeof(Scene));
+	scene->items = g_array_new(FALSE, TRUE, sizeof(SceneItem));
+	scene->first_free = 0;
+
+	return scene;
+}
+
+void
+scene_free(Scene *scene)
+{
+	SceneItem *item;
+	guint i;
+
+	for (i = 0; i < scene->items->len; ++i) {
+		item = &g_array_index(scene->items, SceneItem, i);
+		if (item->kind != SCENE_KIND_NONE) {
+			clear_item(item);
+		}
+	}
+
+	g_array_free(scene->items, TRUE);
+	g_free(scene);
+}
+
+guint
+scene_add(Scene *scene, SceneKind kind, GList *points)
+{
+	SceneItem *item;
+	guint id;
+
+	g_return_val_if_fail(kind > SCENE_KIND_NONE && kind < SCENE_N_KINDS, 0);
+
+	if (scene->first_free != 0) {
+		id = scene->first_free;
+		item = scene_get(scene, id);
+		scene->first_free = item->next_free;
+	} else {
+		g_array_set_size(scene->items, scene->items->len + 1);
+		id = scene->items->len;
+		item = scene_get(scene, id);
+	}
+
+	item->kind = kind;
+	item->points = points;
+	item->segments = g_ptr_array_new();
+	item->next_free = 0;
+
+	return id;
+}
+
+void
+scene_remove(Scene *scene, guint id)
+{
+	SceneItem *item;
+
+	item = scene_get(scene, id);
+	g_return_if_fail(item->kind != SCENE_KIND_NONE);
+
+	clear_item(item);
+	item->next_free = scene->first_free;
+	scene->first_free = id;
+}
+
+SceneItem *
+scene_get(Scene *scene, guint id)
+{
+	g_return_val_if_fail(id > 0 && id <= scene->items->len, NULL);
+
+	return &g_array_index(scene->items, SceneItem, id - 1);
+}
+
+void
+scene_foreach(Scene *scene, SceneKind kind, SceneFunc func, gpointer user_data)
+{
+	SceneItem *item;
+	guint i;
+
+	for (i = 0; i < scene->items->len; ++i) {
+		item = &g_array_index(scene->items, SceneItem, i);
+		if (item->kind != SCENE_KIND_NONE && (kind == SCENE_KIND_NONE || item->kind == kind)) {
+			func(i + 1, item, user_data);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef __SCENE_H
+#define __SCENE_H
+
+#include "drawingpane_utils.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Every figure of a drawing, kept in one array of slots. An item is
+ * known by its id, which stays the same until the item is removed;
+ * ids of removed items are reused, the last removed first, so undoing
+ * removals in reverse order gets their ids back. Adding and removing
+ * items are O(1).
+ */
+typedef struct _Scene Scene;
+
+/* Kinds are stored in documents by value, new kinds go last */
+typedef enum {
+	SCENE_KIND_NONE, // free slot
+	SCENE_KIND_DDA_LINE,
+	SCENE_KIND_BRESENHAM_LINE,
+	SCENE_KIND_WU_LINE,
+	SCENE_KIND_ELLIPSE,
+	SCENE_KIND_HYPERBOLE,
+	SCENE_KIND_BEZIER,
+	SCENE_KIND_HERMITIAN,
+	SCENE_KIND_B_SPLINE,
+	SCENE_N_KINDS
+} SceneKind;
+
+#define SCENE_MAX_PARAMS 8
+#define SCENE_MAX_COORDINATE HYPERBOLE_MAX_COORDINATE
+
+/*
+ * A figure, or a segment of a spline, given by its parameters. Pixels
+ * are rasterized on the first scene_figure_get_pixels(); until then
+ * the bounds enclose every pixel the figure can have.
+ */
+typedef struct _Figure Figure;
+struct _Figure {
+	SceneKind kind;
+	gint params[SCENE_MAX_PARAMS];
+	GArray *pixels;
+	Bounds bounds;
+	gboolean is_empty;
+};
+
+typedef struct _SceneItem SceneItem;
+struct _SceneItem {
+	SceneKind kind;
+	GList *points; // control points of splines
+	GPtrArray *segments; // Figure of every segment, in order
+	guint next_free; // id of the next free slot, for free slots
+};
+
+/*
+ * Parameters of the figure kinds:
+ * lines - x1, y1, x2, y2;
+ * ellipse and hyperbole - a, b and the zone x0, y0, width, height;
+ * spline segments - x and y of the four control points.
+ */
+typedef struct _SceneKindInfo SceneKindInfo;
+struct _SceneKindInfo {
+	const gchar *name;
+	gint n_params;
+	GArray *(*rasterize)(const gint *params);
+	GArray *(*rasterize_clipped)(const gint *params, const Bounds *clip); // NULL if not supported
+	gboolean (*get_bounds)(const gint *params, Bounds *bounds); // FALSE if empty
+	guint (*get_segment_count)(guint n_points); // NULL for single figures
+};
+
+extern const SceneKindInfo scene_kinds[SCENE_N_KINDS];
+
+/* Kind with the name of length bytes, in any case; SCENE_KIND_NONE if none */
+SceneKind scene_kind_from_name(const gchar *name, gsize length);
+
+/*
+ * Returns why the n values are not the parameters of a figure of kind,
+ * or the control point coordinates of a spline, NULL if they are.
+ * Every value must be at most SCENE_MAX_COORDINATE in magnitude.
+ */
+const gchar *scene_check_values(SceneKind kind, const gint *values, guint n);
+
+typedef void (*SceneFunc)(guint id, SceneItem *item, gpointer user_data);
+
+Scene *scene_new(void);
+
+/* Frees every item with its points and segments */
+void scene_free(Scene *scene);
+
+/* Takes ownership of points. The new item has no segments yet */
+guint scene_add(Scene *scene, SceneKind kind, GList *points);
+void scene_remove(Scene *scene, guint id);
+
+/* The item stays at this address until the next scene_add */
+SceneItem *scene_get(Scene *scene, guint id);
+
+/* Calls func for every item of kind, or for all items for SCENE_KIND_NONE */
+void scene_foreach(Scene *scene, SceneKind kind, SceneFunc func, gpointer user_data);
+
+/*
+ * Add an item of a figure kind with its single segment, or a spline
+ * with all its segments. Splines take ownership of points.
+ */
+guint scene_add_figure(Scene *scene, SceneKind kind, const gint *params);
+guint scene_add_spline(Scene *scene, SceneKind kind, GList *points);
+
+/* Parameters of segment index of a spline item */
+void scene_get_segment_params(SceneItem *item, guint index, gint *params);
+
+Figure *scene_figure_new(SceneKind kind, const gint *params);
+void scene_figure_free(Figure *figure);
+GArray *scene_figure_get_pixels(Figure *figure);
+
+G_END_DECLS
+
+#endif /* __SCENE_H */
@@ -0,0 +1,240 @@
+#include "spatial_grid.h"
+
+#define MAX_ITEM_CELLS 256
+
+typedef struct _GridCell GridCell;
+struct _GridCell {
+	gint x, y;
+};
+
+typedef struct _GridEntry GridEntry;
+struct _GridEntry {
+	gpointer item;
+	Bounds bounds;
+};
+
+struct _SpatialGrid {
+	gint cell_size;
+	GHashTable *cells; // GridCell -> GArray of GridEntry
+	GArray *large_items;
+};
+
+static guint cell_hash(gconstpointer key);
+static gboolean cell_equal(gconstpointer a, gconstpointer b);
+static gint cell_coordinate(SpatialGrid *grid, gint x);
+static gboolean is_large(SpatialGrid *grid, const Bounds *bounds);
+static void remove_entry(GArray *entries, gpointer item);
+static void query_entries(GArray *entries, const Bounds *bounds, GridCell *cell, SpatialGrid *grid,
+		SpatialGridFunc func, gpointer user_data);
+
+static guint
+cell_hash(gconstpointer key)
+{
+	const GridCell *cell = key;
+
+	return (guint) cell->x * 73856093u ^ (guint) cell->y * 19349663u;
+}
+
+static gboolean
+cell_equal(gconstpointer a, gconstpointer b)
+{
+	const GridCell *cell_a = a;
+	const GridCell *cell_b = b;
+
+	return cell_a->x == cell_b->x && cell_a->y == cell_b->y;
+}
+
+static gint
+cell_coordinate(SpatialGrid *grid, gint x)
+{
+	// Rounding towards minus infinity
+	return x >= 0 ? x / grid->cell_size : - ((- x - 1) / grid->cell_size) - 1;
+}
+
+static gboolean
+is_large(SpatialGrid *grid, const Bounds *bounds)
+{
+	gint64 columns, rows;
+
+	columns = (gint64) cell_coordinate(grid, bounds->x2) - cell_coordinate(grid, bounds->x1) + 1;
+	rows = (gint64) cell_coordinate(grid, bounds->y2) - cell_coordinate(grid, bounds->y1) + 1;
+
+	return columns * rows > MAX_ITEM_CELLS;
+}
+
+SpatialGrid *
+spatial_grid_new(gint cell_size)
+{
+	SpatialGrid *grid;
+
+	grid = g_malloc(sizeof(SpatialGrid));
+	grid->cell_size = MAX(cell_size, 1);
+	grid->cells = g_hash_table_new_full(cell_hash, cell_equal, g_free, (GDestroyNotify) g_array_unref);
+	grid->large_items = g_array_new(FALSE, FALSE, sizeof(GridEntry));
+
+	return grid;
+}
+
+void
+spatial_grid_free(SpatialGrid *grid)
+{
+	if (grid == NULL) {
+		return;
+	}
+
+	g_hash_table_unref(grid->cells);
+	g_array_unref(grid->large_items);
+	g_free(grid);
+}
+
+void
+spatial_grid_insert(SpatialGrid *grid, gpointer item, const Bounds *bounds)
+{
+	GridEntry entry;
+	GridCell cell;
+	GridCell *key;
+	GArray *entries;
+	gint x1, x2, y1, y2;
+
+	entry.item = item;
+	entry.bounds = *bounds;
+
+	if (is_large(grid, bounds)) {
+		g_array_append_val(grid->large_items, entry);
+		return;
+	}
+
+	x1 = cell_coordinate(grid, bounds->x1);
+	x2 = cell_coordinate(grid, bounds->x2);
+	y1 = cell_coordinate(grid, bounds->y1);
+	y2 = cell_coordinate(grid, bounds->y2);
+
+	for (cell.y = y1; cell.y <= y2; ++cell.y) {
+		for (cell.x = x1; cell.x <= x2; ++cell.x) {
+			entries = g_hash_table_lookup(grid->cells, &cell);
+
+			if (entries == NULL) {
+				key = g_malloc(sizeof(GridCell));
+				*key = cell;
+
+				entries = g_array_new(FALSE, FALSE, sizeof(GridEntry));
+				g_hash_table_insert(grid->cells, key, entries);
+			}
+
+			g_array_append_val(entries, entry);
+		}
+	}
+}
+
+// Items are mostly removed newest first, e.g. on undo, so the search
+// starts from the end
+static void
+remove_entry(GArray *entries, gpointer item)
+{
+	guint i;
+
+	for (i = entries->len; i-- > 0;) {
+		if (g_array_index(entries, GridEntry, i).item == item) {
+			g_array_remove_index_fast(entries, i);
+			return;
+		}
+	}
+}
+
+void
+spatial_grid_remove(SpatialGrid *grid, gpointer item, const Bounds *bounds)
+{
+	GridCell cell;
+	GArray *entries;
+	gint x1, x2, y1, y2;
+
+	if (is_large(grid, bounds)) {
+		remove_entry(grid->large_items, item);
+		return;
+	}
+
+	x1 = cell_coordinate(grid, bounds->x1);
+	x2 = cell_coordinate(grid, bounds->x2);
+	y1 = cell_coordinate(grid, bounds->y1);
+	y2 = cell_coordinate(grid, bounds->y2);
+
+	for (cell.y = y1; cell.y <= y2; ++cell.y) {
+		for (cell.x = x1; cell.x <= x2; ++cell.x) {
+			entries = g_hash_table_lookup(grid->cells, &cell);
+
+			if (entries != NULL) {
+				remove_entry(entries, item);
+
+				if (entries->len == 0) {
+					g_hash_table_remove(grid->cells, &cell);
+				}
+			}
+		}
+	}
+}
+
+// An item stored in several cells is reported only from the cell that
+// holds the top-left corner of its intersection with the query
+static void
+query_entries(GArray *entries, const Bounds *bounds, GridCell *cell, SpatialGrid *grid,
+		SpatialGridFunc func, gpointer user_data)
+{
+	GridEntry *entry;
+	guint i;
+
+	for (i = 0; i < entries->len; ++i) {
+		entry = &g_array_index(entries, GridEntry, i);
+
+		if (!bounds_intersect(&entry->bounds, bounds)) {
+			continue;
+		}
+
+		if (cell != NULL &&
+				(cell_coordinate(grid, MAX(entry->bounds.x1, bounds->x1)) != cell->x ||
+				cell_coordinate(grid, MAX(entry->bounds.y1, bounds->y1)) != cell->y)) {
+			continue;
+		}
+
+		func(entry->item, &entry->bounds, user_data);
+	}
+}
+
+void
+spatial_grid_query(SpatialGrid *grid, const Bounds *bounds, SpatialGridFunc func, gpointer user_data)
+{
+	GridCell cell;
+	GArray *entries;
+	gint x1, x2, y1, y2;
+
+	query_entries(grid->large_items, bounds, NULL, grid, func, user_data);
+
+	x1 = cell_coordinate(grid, bounds->x1);
+	x2 = cell_coordinate(grid, bounds->x2);
+	y1 = cell_coordinate(grid, bounds->y1);
+	y2 = cell_coordinate(grid, bounds->y2);
+
+	if (((gint64) x2 - x1 + 1) * ((gint64) y2 - y1 + 1) > g_hash_table_size(grid->cells)) {
+		GHashTableIter iter;
+		gpointer key, value;
+
+		// Query covers more cells than are occupied
+		g_hash_table_iter_init(&iter, grid->cells);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			cell = *(GridCell *) key;
+			if (cell.x >= x1 && cell.x <= x2 && cell.y >= y1 && cell.y <= y2) {
+				query_entries(value, bounds, &cell, grid, func, user_data);
+			}
+		}
+		return;
+	}
+
+	for (cell.y = y1; cell.y <= y2; ++cell.y) {
+		for (cell.x = x1; cell.x <= x2; ++cell.x) {
+			entries = g_hash_table_lookup(grid->cells, &cell);
+
+			if (entries != NULL) {
+				query_entries(entries, bounds, &cell, grid, func, user_data);
+			}
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef __SPATIAL_GRID_H
+#define __SPATIAL_GRID_H
+
+#include "drawingpane_utils.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Uniform grid over bounding boxes. Every item is stored in each cell
+ * its bounds overlap; items covering too many cells are kept in
+ * a separate list that is checked by every query.
+ */
+typedef struct _SpatialGrid SpatialGrid;
+
+typedef void (*SpatialGridFunc)(gpointer item, const Bounds *bounds, gpointer user_data);
+
+SpatialGrid *spatial_grid_new(gint cell_size);
+void spatial_grid_free(SpatialGrid *grid);
+void spatial_grid_insert(SpatialGrid *grid, gpointer item, const Bounds *bounds);
+void spatial_grid_remove(SpatialGrid *grid, gpointer item, const Bounds *bounds);
+
+/* Calls func once for every item whose bounds intersect bounds */
+void spatial_grid_query(SpatialGrid *grid, const Bounds *bounds, SpatialGridFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __SPATIAL_GRID_H */
@@ -0,0 +1,149 @@
+#include "tile_cache.h"
+
+typedef struct _TileKey TileKey;
+struct _TileKey {
+	gint zoom, tx, ty;
+};
+
+typedef struct _TileEntry TileEntry;
+struct _TileEntry {
+	TileKey key;
+	gpointer tile;
+	gsize size;
+	GList link; // node in lru, most recently used first
+};
+
+struct _TileCache {
+	gsize budget;
+	gsize size;
+	GDestroyNotify tile_free;
+	GHashTable *entries; // TileKey -> TileEntry
+	GQueue lru;
+};
+
+static guint key_hash(gconstpointer key);
+static gboolean key_equal(gconstpointer a, gconstpointer b);
+static void remove_entry(TileCache *cache, TileEntry *entry);
+
+static guint
+key_hash(gconstpointer key)
+{
+	const TileKey *tile_key = key;
+
+	return (guint) tile_key->zoom * 83492791u
+			^ (guint) tile_key->tx * 73856093u
+			^ (guint) tile_key->ty * 19349663u;
+}
+
+static gboolean
+key_equal(gconstpointer a, gconstpointer b)
+{
+	const TileKey *key_a = a;
+	const TileKey *key_b = b;
+
+	return key_a->zoom == key_b->zoom && key_a->tx == key_b->tx && key_a->ty == key_b->ty;
+}
+
+static void
+remove_entry(TileCache *cache, TileEntry *entry)
+{
+	g_queue_unlink(&cache->lru, &entry->link);
+	cache->size -= entry->size;
+
+	if (cache->tile_free != NULL) {
+		cache->tile_free(entry->tile);
+	}
+
+	g_hash_table_remove(cache->entries, &entry->key);
+}
+
+TileCache *
+tile_cache_new(gsize budget, GDestroyNotify tile_free)
+{
+	TileCache *cache;
+
+	cache = g_malloc(sizeof(TileCache));
+	cache->budget = budget;
+	cache->size = 0;
+	cache->tile_free = tile_free;
+	cache->entries = g_hash_table_new_full(key_hash, key_equal, NULL, g_free);
+	g_queue_init(&cache->lru);
+
+	return cache;
+}
+
+void
+tile_cache_free(TileCache *cache)
+{
+	tile_cache_clear(cache);
+	g_hash_table_unref(cache->entries);
+	g_free(cache);
+}
+
+gpointer
+tile_cache_lookup(TileCache *cache, gint zoom, gint tx, gint ty)
+{
+	TileKey key = {zoom, tx, ty};
+	TileEntry *entry;
+
+	entry = g_hash_table_lookup(cache->entries, &key);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	g_queue_unlink(&cache->lru, &entry->link);
+	g_queue_push_head_link(&cache->lru, &entry->link);
+
+	return entry->tile;
+}
+
+void
+tile_cache_insert(TileCache *cache, gint zoom, gint tx, gint ty, gpointer tile, gsize size)
+{
+	TileKey key = {zoom, tx, ty};
+	TileEntry *entry;
+
+	entry = g_hash_table_lookup(cache->entries, &key);
+	if (entry != NULL) {
+		remove_entry(cache, entry);
+	}
+
+	entry = g_malloc0(sizeof(TileEntry));
+	entry->key = key;
+	entry->tile = tile;
+	entry->size = size;
+	entry->link.data = entry;
+
+	g_hash_table_insert(cache->entries, &entry->key, entry);
+	g_queue_push_head_link(&cache->lru, &entry->link);
+	cache->size += size;
+
+	// The new tile itself is kept even if it alone exceeds the budget
+	while (cache->size > cache->budget && cache->lru.tail != &entry->link) {
+		remove_entry(cache, cache->lru.tail->data);
+	}
+}
+
+void
+tile_cache_remove_if(TileCache *cache, TileCacheFunc func, gpointer user_data)
+{
+	GList *link, *next;
+	TileEntry *entry;
+
+	for (link = cache->lru.head; link != NULL; link = next) {
+		next = link->next;
+		entry = link->data;
+
+		if (func(entry->key.zoom, entry->key.tx, entry->key.ty, entry->tile, user_data)) {
+			remove_entry(cache, entry);
+		}
+	}
+}
+
+void
+tile_cache_clear(TileCache *cache)
+{
+	while (cache->lru.head != NULL) {
+		remove_entry(cache, cache->lru.head->data);
+	}
+}
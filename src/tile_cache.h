@@ -0,0 +1,32 @@
+#ifndef __TILE_CACHE_H
+#define __TILE_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Rendered tiles keyed by (zoom, tile column, tile row). The least
+ * recently used tiles are dropped once the total size of the cached
+ * tiles exceeds the memory budget.
+ */
+typedef struct _TileCache TileCache;
+
+typedef gboolean (*TileCacheFunc)(gint zoom, gint tx, gint ty, gpointer tile, gpointer user_data);
+
+TileCache *tile_cache_new(gsize budget, GDestroyNotify tile_free);
+void tile_cache_free(TileCache *cache);
+
+/* Returns NULL for a tile that is not cached */
+gpointer tile_cache_lookup(TileCache *cache, gint zoom, gint tx, gint ty);
+
+/* Takes ownership of tile, replacing a cached tile with the same key */
+void tile_cache_insert(TileCache *cache, gint zoom, gint tx, gint ty, gpointer tile, gsize size);
+
+/* Drops every tile for which func returns TRUE */
+void tile_cache_remove_if(TileCache *cache, TileCacheFunc func, gpointer user_data);
+void tile_cache_clear(TileCache *cache);
+
+G_END_DECLS
+
+#endif /* __TILE_CACHE_H */